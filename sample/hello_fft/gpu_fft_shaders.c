@@ -26,71 +26,47 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-static unsigned int shader_256[] = {
-    #include "hex/shader_256.hex"
-};
-static unsigned int shader_512[] = {
-    #include "hex/shader_512.hex"
-};
-static unsigned int shader_1k[] = {
-    #include "hex/shader_1k.hex"
-};
-static unsigned int shader_2k[] = {
-    #include "hex/shader_2k.hex"
-};
-static unsigned int shader_4k[] = {
-    #include "hex/shader_4k.hex"
-};
-static unsigned int shader_8k[] = {
-    #include "hex/shader_8k.hex"
-};
-static unsigned int shader_16k[] = {
-    #include "hex/shader_16k.hex"
-};
-static unsigned int shader_32k[] = {
-    #include "hex/shader_32k.hex"
-};
-static unsigned int shader_64k[] = {
-    #include "hex/shader_64k.hex"
-};
-static unsigned int shader_128k[] = {
-    #include "hex/shader_128k.hex"
-};
-static unsigned int shader_256k[] = {
-    #include "hex/shader_256k.hex"
-};
-static unsigned int shader_512k[] = {
-    #include "hex/shader_512k.hex"
-};
-static unsigned int shader_1024k[] = {
-    #include "hex/shader_1024k.hex"
-};
-static unsigned int shader_2048k[] = {
-    #include "hex/shader_2048k.hex"
-};
+/* The shaders are linked as ELF objects written by vc4asm -e. */
+#define SHADER(n) extern unsigned int shader_##n##_start[], shader_##n##_end[];
+SHADER(256)
+SHADER(512)
+SHADER(1k)
+SHADER(2k)
+SHADER(4k)
+SHADER(8k)
+SHADER(16k)
+SHADER(32k)
+SHADER(64k)
+SHADER(128k)
+SHADER(256k)
+SHADER(512k)
+SHADER(1024k)
+SHADER(2048k)
+
+#define ENTRY(n) {shader_##n##_start, shader_##n##_end}
 
 static struct {
-    unsigned int size, *code;
+    unsigned int *code, *end;
 }
 shaders[] = {
-    {sizeof(shader_256), shader_256},
-    {sizeof(shader_512), shader_512},
-    {sizeof(shader_1k), shader_1k},
-    {sizeof(shader_2k), shader_2k},
-    {sizeof(shader_4k), shader_4k},
-    {sizeof(shader_8k), shader_8k},
-    {sizeof(shader_16k), shader_16k},
-    {sizeof(shader_32k), shader_32k},
-    {sizeof(shader_64k), shader_64k},
-    {sizeof(shader_128k), shader_128k},
-    {sizeof(shader_256k), shader_256k},
-    {sizeof(shader_512k), shader_512k},
-    {sizeof(shader_1024k), shader_1024k},
-    {sizeof(shader_2048k), shader_2048k}
+    ENTRY(256),
+    ENTRY(512),
+    ENTRY(1k),
+    ENTRY(2k),
+    ENTRY(4k),
+    ENTRY(8k),
+    ENTRY(16k),
+    ENTRY(32k),
+    ENTRY(64k),
+    ENTRY(128k),
+    ENTRY(256k),
+    ENTRY(512k),
+    ENTRY(1024k),
+    ENTRY(2048k)
 };
 
 unsigned int  gpu_fft_shader_size(int log2_N) {
-    return shaders[log2_N-8].size;
+    return (char *)shaders[log2_N-8].end - (char *)shaders[log2_N-8].code;
 }
 
 unsigned int *gpu_fft_shader_code(int log2_N) {
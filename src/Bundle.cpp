@@ -0,0 +1,110 @@
+/*
+ * Bundle.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Bundle.h"
+#include "vc4bundle.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <cerrno>
+
+
+static void put32(string& dst, uint32_t value)
+{	for (unsigned i = 0; i < 32; i += 8)
+		dst.push_back((char)(value >> i));
+}
+
+static void align(string& dst, size_t alignment)
+{	dst.append(-dst.size() & (alignment - 1), '\0');
+}
+
+bool writeBundle(const char* path, const vector<bundleProgram>& programs)
+{	// The hash table is at most half full.
+	uint32_t slots = 1;
+	while (slots < 2 * programs.size())
+		slots <<= 1;
+	size_t entrycount = 0;
+	for (const auto& prog : programs)
+		entrycount += prog.Entries->size();
+
+	// Sections in order of the file
+	uint32_t slotpos = sizeof(vc4_bundle_header);
+	uint32_t programpos = (slotpos + slots * sizeof(uint32_t) + 7) & ~7;
+	uint32_t entrypos = programpos + programs.size() * sizeof(vc4_bundle_program);
+	string strings;
+	string index; // hash table, programs and entry labels
+	vector<uint32_t> table(slots);
+	for (unsigned i = 0; i < programs.size(); ++i)
+	{	uint32_t slot = vc4_bundle_hash(programs[i].Name.c_str());
+		while (table[slot &= slots - 1])
+			++slot;
+		table[slot] = i + 1;
+	}
+	for (uint32_t n : table)
+		put32(index, n);
+	align(index, 8);
+
+	uint32_t stringpos = entrypos + entrycount * sizeof(vc4_bundle_entry);
+	uint32_t codepos = stringpos;
+	for (const auto& prog : programs)
+	{	codepos += prog.Name.size() + 1;
+		for (const auto& entry : *prog.Entries)
+			codepos += entry.first.size() + 1;
+	}
+	codepos = (codepos + 7) & ~7;
+
+	string entries;
+	string code; // always little endian
+	uint32_t entry = 0;
+	for (const auto& prog : programs)
+	{	size_t start = code.size();
+		for (uint64_t inst : *prog.Code)
+		{	put32(code, (uint32_t)inst);
+			put32(code, (uint32_t)(inst >> 32));
+		}
+		uint32_t size = code.size() - start;
+		put32(index, stringpos + strings.size());
+		strings.append(prog.Name.c_str(), prog.Name.size() + 1);
+		put32(index, vc4_bundle_hash(prog.Name.c_str()));
+		put32(index, codepos + start);
+		put32(index, size);
+		put32(index, entry);
+		put32(index, prog.Entries->size());
+		uint64_t checksum = hash64(code.data() + start, size);
+		put32(index, (uint32_t)checksum);
+		put32(index, (uint32_t)(checksum >> 32));
+		for (const auto& e : *prog.Entries)
+		{	put32(entries, stringpos + strings.size());
+			strings.append(e.first.c_str(), e.first.size() + 1);
+			put32(entries, e.second);
+		}
+		entry += prog.Entries->size();
+	}
+
+	string out(VC4_BUNDLE_MAGIC, 4);
+	put32(out, VC4_BUNDLE_VERSION);
+	put32(out, programs.size());
+	put32(out, slots);
+	put32(out, slotpos);
+	put32(out, programpos);
+	put32(out, entrypos);
+	put32(out, codepos + code.size());
+	out.append(index);
+	out.append(entries);
+	out.append(strings);
+	align(out, 8);
+	out.append(code);
+
+	FILE* of = fopen(path, "wb");
+	if (!of)
+		return false;
+	bool ok = fwrite(out.data(), 1, out.size(), of) == out.size();
+	int err = errno;
+	ok &= fclose(of) == 0;
+	if (!ok)
+		errno = err;
+	return ok;
+}
@@ -0,0 +1,28 @@
+/*
+ * Bundle.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef BUNDLE_H_
+#define BUNDLE_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/// Program of a bundle.
+struct bundleProgram
+{	string         Name;
+	const vector<uint64_t>* Code;
+	const vector<pair<string,unsigned>>* Entries; ///< Entry labels, see Parser::GetExports
+};
+
+/// Write a bundle of programs with an index for the loader in vc4bundle.h.
+/// The names must be unique.
+/// @return false on error, errno is set in this case.
+bool writeBundle(const char* path, const vector<bundleProgram>& programs);
+
+#endif // BUNDLE_H_
@@ -0,0 +1,179 @@
+/*
+ * Cache.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+const char Cache::Magic[4] = { 'V','C','4','c' }; // change when the entry layout changes
+
+Cache::Cache(const string& dir)
+:	Dir(dir)
+{	mkdir(dir.c_str(), 0777);
+}
+
+string Cache::path(uint64_t key, const char* ext) const
+{	return stringf("%s/%016" PRIx64 "%s", Dir.c_str(), key, ext);
+}
+
+uint64_t Cache::resultKey(uint64_t command, const vector<Parser::dependency>& deps)
+{	uint64_t key = hash64(&command, sizeof command);
+	for (const auto& dep : deps)
+	{	key = hash64(dep.File.c_str(), dep.File.size() + 1, key);
+		key = hash64(&dep.Hash, sizeof dep.Hash, key);
+	}
+	return key;
+}
+
+bool Cache::readDeps(uint64_t command, vector<Parser::dependency>& deps) const
+{	fileContent content;
+	if (!content.load(path(command, ".dep").c_str()))
+		return false;
+	// One line per dependency: <hash> <file> or - <file> if the file does not exist.
+	const char* cp = content.data();
+	const char* end = cp + content.size();
+	while (cp != end)
+	{	const char* eol = (const char*)memchr(cp, '\n', end - cp);
+		if (!eol)
+			return false;
+		Parser::dependency dep;
+		char* ep;
+		if (*cp == '-')
+		{	dep.Exists = false;
+			dep.Hash = 0;
+			ep = (char*)cp + 1;
+		} else
+		{	dep.Exists = true;
+			dep.Hash = strtoull(cp, &ep, 16);
+		}
+		if (*ep != ' ' || ep >= eol)
+			return false;
+		dep.File.assign(ep + 1, eol - ep - 1);
+		deps.push_back(move(dep));
+		cp = eol + 1;
+	}
+	return true;
+}
+
+bool Cache::writeFile(const string& path, const void* data, size_t size) const
+{	string tmp = path + ".XXXXXX";
+	int fd = mkstemp(&tmp[0]);
+	if (fd < 0)
+		return false;
+	bool ok = write(fd, data, size) == (ssize_t)size;
+	ok &= ::close(fd) == 0;
+	if (ok && rename(tmp.c_str(), path.c_str()) == 0)
+		return true;
+	unlink(tmp.c_str());
+	return false;
+}
+
+bool Cache::Lookup(uint64_t command, result& res) const
+{	vector<Parser::dependency> deps;
+	if (!readDeps(command, deps))
+		return false;
+	// Check whether any dependency changed.
+	fileContent content;
+	for (const auto& dep : deps)
+	{	bool exists = content.load(dep.File.c_str());
+		if (exists != dep.Exists || (exists && hash64(content.data(), content.size()) != dep.Hash))
+			return false;
+	}
+	content.close();
+
+	if (!content.load(path(resultKey(command, deps), ".out").c_str()) || content.size() < sizeof(header))
+		return false;
+	header hdr;
+	memcpy(&hdr, content.data(), sizeof hdr);
+	size_t size = sizeof hdr + hdr.Count * sizeof(uint64_t) + hdr.RelocCount * sizeof(uint32_t) + hdr.ExportSize + hdr.LogSize;
+	// fileContent appends a line feed to files that do not end with one.
+	if (memcmp(hdr.Magic, Magic, sizeof Magic) != 0 || (content.size() != size && content.size() != size + 1))
+		return false;
+	const char* cp = content.data() + sizeof hdr;
+	res.Code.resize(hdr.Count);
+	memcpy(res.Code.data(), cp, hdr.Count * sizeof(uint64_t));
+	cp += hdr.Count * sizeof(uint64_t);
+	res.Relocs.resize(hdr.RelocCount);
+	memcpy(res.Relocs.data(), cp, hdr.RelocCount * sizeof(uint32_t));
+	cp += hdr.RelocCount * sizeof(uint32_t);
+	res.Exports.clear();
+	const char* end = cp + hdr.ExportSize;
+	while (end - cp > (ptrdiff_t)sizeof(uint32_t))
+	{	uint32_t value;
+		memcpy(&value, cp, sizeof value);
+		cp += sizeof value;
+		size_t len = strnlen(cp, end - cp);
+		res.Exports.emplace_back(string(cp, len), value);
+		cp += len + 1;
+	}
+	cp = end;
+	res.Log.assign(cp, hdr.LogSize);
+	return true;
+}
+
+void Cache::Store(uint64_t command, const vector<Parser::dependency>& deps, const result& res) const
+{	// Write the result first, the dependency list refers to it.
+	header hdr;
+	memcpy(hdr.Magic, Magic, sizeof Magic);
+	hdr.Count = res.Code.size();
+	hdr.LogSize = res.Log.size();
+	hdr.RelocCount = res.Relocs.size();
+	hdr.Reserved = 0;
+	string exports;
+	for (const auto& e : res.Exports)
+	{	uint32_t value = e.second;
+		exports.append((const char*)&value, sizeof value);
+		exports.append(e.first.c_str(), e.first.size() + 1);
+	}
+	hdr.ExportSize = exports.size();
+	string out((const char*)&hdr, sizeof hdr);
+	out.append((const char*)res.Code.data(), res.Code.size() * sizeof(uint64_t));
+	out.append((const char*)res.Relocs.data(), res.Relocs.size() * sizeof(uint32_t));
+	out.append(exports);
+	out.append(res.Log);
+	if (!writeFile(path(resultKey(command, deps), ".out"), out.data(), out.size()))
+		return;
+
+	string dep;
+	for (const auto& d : deps)
+	{	if (d.File.find('\n') != string::npos)
+			return; // not supported
+		if (d.Exists)
+			dep += stringf("%016" PRIx64 " %s\n", d.Hash, d.File.c_str());
+		else
+			dep += "- " + d.File + '\n';
+	}
+	writeFile(path(command, ".dep"), dep.data(), dep.size());
+}
+
+
+bool MemoryCache::Lookup(uint64_t command, Cache::result& res)
+{	lock_guard<mutex> lock(Lock);
+	auto it = Entries.find(command);
+	if (it == Entries.end())
+		return false;
+	fileStamp stamp;
+	for (const auto& dep : it->second.Deps)
+	{	stamp.load(dep.File.c_str());
+		if (stamp != dep.Stamp)
+		{	Entries.erase(it);
+			return false;
+		}
+	}
+	res = it->second.Result;
+	return true;
+}
+
+void MemoryCache::Store(uint64_t command, const vector<Parser::dependency>& deps, const Cache::result& res)
+{	lock_guard<mutex> lock(Lock);
+	entry& e = Entries[command];
+	e.Deps = deps;
+	e.Result = res;
+}
@@ -0,0 +1,86 @@
+/*
+ * Cache.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "Parser.h"
+
+#include <inttypes.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+using namespace std;
+
+/// Persistent cache of assembled programs in a directory.
+/// A program is identified by the hash of its command, i.e. the assembler version,
+/// options and input files, and by the content of all source files that
+/// the parser looked up.
+/// For each command <command>.dep lists the dependencies of the last assembly.
+/// The results are stored in <key>.out where the key also covers the content of the dependencies.
+class Cache
+{	const string   Dir;
+ public:
+	/// Result of an assembly.
+	struct result
+	{	vector<uint64_t> Code;
+		vector<uint32_t> Relocs;    ///< Only if requested, see Parser::GetRelocations
+		vector<pair<string,unsigned>> Exports; ///< See Parser::GetExports
+		string         Log;         ///< Messages
+	};
+ private:
+	/// File header of <key>.out
+	struct header
+	{	char           Magic[4];
+		uint32_t       Count;       ///< Number of instructions
+		uint32_t       LogSize;     ///< Length of the log following the exports
+		uint32_t       RelocCount;  ///< Number of relocations following the instructions
+		uint32_t       ExportSize;  ///< Length of the exports following the relocations, value and name with '\0' each
+		uint32_t       Reserved;    ///< Keep the instructions aligned
+	};
+	static const char Magic[4];
+
+	string           path(uint64_t key, const char* ext) const;
+	/// Key of the result of a command with a given set of dependencies.
+	static uint64_t  resultKey(uint64_t command, const vector<Parser::dependency>& deps);
+	bool             readDeps(uint64_t command, vector<Parser::dependency>& deps) const;
+	/// Replace a file atomically.
+	bool             writeFile(const string& path, const void* data, size_t size) const;
+ public:
+	/// Use the cache directory dir, it is created if it does not exist.
+	                 Cache(const string& dir);
+	/// Look up the result of a command.
+	/// @param command Hash of the command.
+	/// @param res [out] Cached result.
+	/// @return true if the cached result is up to date.
+	bool             Lookup(uint64_t command, result& res) const;
+	/// Store the result of a successful assembly.
+	/// Errors are ignored, this only results in a cache miss next time.
+	/// @param deps Dependencies of the result, see Parser::GetDependencies.
+	void             Store(uint64_t command, const vector<Parser::dependency>& deps, const result& res) const;
+};
+
+/// In memory cache of assembled programs for a resident assembler.
+/// Entries are validated by the modification time and size of their dependencies
+/// rather than by the file content.
+class MemoryCache
+{	struct entry
+	{	vector<Parser::dependency> Deps;
+		Cache::result  Result;
+	};
+	mutex            Lock;
+	unordered_map<uint64_t,entry> Entries;
+ public:
+	/// Look up the result of a command.
+	/// @return true if no dependency changed since the result has been stored.
+	bool             Lookup(uint64_t command, Cache::result& res);
+	/// Store the result of a successful assembly, replacing older results of the same command.
+	void             Store(uint64_t command, const vector<Parser::dependency>& deps, const Cache::result& res);
+};
+
+#endif // CACHE_H_
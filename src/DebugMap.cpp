@@ -0,0 +1,174 @@
+/*
+ * DebugMap.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "DebugMap.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+
+
+const char DebugMap::Magic[4] = { 'V','C','4','G' };
+
+static void put32(string& dst, uint32_t value)
+{	for (unsigned i = 0; i < 32; i += 8)
+		dst.push_back((char)(value >> i));
+}
+
+static uint32_t get32(const char*& cp)
+{	uint32_t value = 0;
+	for (unsigned i = 0; i < 32; i += 8)
+		value |= (uint32_t)(uint8_t)*cp++ << i;
+	return value;
+}
+
+bool DebugMap::Save(const char* path) const
+{	string strings;
+	string out(Magic, sizeof Magic);
+	put32(out, Version);
+	put32(out, Ranges.size());
+	put32(out, Contexts.size());
+	put32(out, Files.size());
+	put32(out, Labels.size());
+	size_t sizepos = out.size();
+	put32(out, 0); // size of the string table, see below
+	for (const range& r : Ranges)
+	{	put32(out, r.Inst);
+		put32(out, r.Context);
+		put32(out, r.Column);
+		put32(out, r.Label);
+	}
+	for (const context& ctx : Contexts)
+	{	put32(out, ctx.Parent);
+		put32(out, ctx.Type);
+		put32(out, ctx.File);
+		put32(out, ctx.Line);
+	}
+	for (const string& file : Files)
+	{	put32(out, strings.size());
+		strings.append(file.c_str(), file.size() + 1);
+	}
+	for (const label& l : Labels)
+	{	put32(out, strings.size());
+		strings.append(l.Name.c_str(), l.Name.size() + 1);
+		put32(out, l.Value);
+	}
+	string size;
+	put32(size, strings.size());
+	out.replace(sizepos, size.size(), size);
+	out.append(strings);
+
+	FILE* of = fopen(path, "wb");
+	if (!of)
+		return false;
+	bool ok = fwrite(out.data(), 1, out.size(), of) == out.size();
+	int err = errno;
+	ok &= fclose(of) == 0;
+	if (!ok)
+		errno = err;
+	return ok;
+}
+
+bool DebugMap::Load(const char* path)
+{	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+	string data;
+	char buf[4096];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof buf, f)) != 0)
+		data.append(buf, len);
+	bool ok = !ferror(f);
+	fclose(f);
+	if (!ok)
+	{	errno = EIO;
+		return false;
+	}
+
+	errno = EINVAL;
+	if (data.size() < 28 || data.compare(0, sizeof Magic, Magic, sizeof Magic) != 0)
+		return false;
+	const char* cp = data.data() + sizeof Magic;
+	if (get32(cp) != Version)
+		return false;
+	uint64_t ranges = get32(cp);
+	uint64_t contexts = get32(cp);
+	uint64_t files = get32(cp);
+	uint64_t labels = get32(cp);
+	uint64_t stringsize = get32(cp);
+	if (data.size() != 28 + (ranges + contexts) * 16 + files * 4 + labels * 8 + stringsize
+		|| (stringsize && data.back() != 0))
+		return false;
+	const char* strings = data.data() + data.size() - stringsize;
+
+	Ranges.resize(ranges);
+	for (range& r : Ranges)
+	{	r.Inst = get32(cp);
+		r.Context = get32(cp);
+		r.Column = get32(cp);
+		r.Label = get32(cp);
+		if (r.Context > contexts || r.Label > labels || (&r != &Ranges.front() && r.Inst <= (&r)[-1].Inst))
+			return false;
+	}
+	Contexts.resize(contexts);
+	for (context& ctx : Contexts)
+	{	ctx.Parent = get32(cp);
+		uint32_t type = get32(cp);
+		ctx.File = get32(cp);
+		ctx.Line = get32(cp);
+		// Parents precede their children.
+		if (ctx.Parent > (uint32_t)(&ctx - Contexts.data()) || type > C_REP || ctx.File >= files)
+			return false;
+		ctx.Type = (contextType)type;
+	}
+	Files.resize(files);
+	for (string& file : Files)
+	{	uint32_t name = get32(cp);
+		if (name >= stringsize)
+			return false;
+		file = strings + name;
+	}
+	Labels.resize(labels);
+	for (label& l : Labels)
+	{	uint32_t name = get32(cp);
+		if (name >= stringsize)
+			return false;
+		l.Name = strings + name;
+		l.Value = get32(cp);
+	}
+	return true;
+}
+
+const DebugMap::range* DebugMap::Find(uint32_t inst) const
+{	// last range that starts at or before inst
+	auto r = upper_bound(Ranges.begin(), Ranges.end(), inst, [](uint32_t i, const range& r) { return i < r.Inst; });
+	return r == Ranges.begin() ? NULL : &r[-1];
+}
+
+string DebugMap::toString(const range& r) const
+{	string ret;
+	const char* via = NULL;
+	for (uint32_t i = r.Context; i; i = Contexts[i-1].Parent)
+	{	const context& ctx = Contexts[i-1];
+		const char* file = Files[ctx.File].c_str();
+		if (!via)
+			ret = stringf("%s (%u,%u)", file, ctx.Line, r.Column);
+		else
+			ret += stringf("\n  %s %s (%u)", via, file, ctx.Line);
+		switch (ctx.Type)
+		{case C_INCLUDE:
+			via = "Included from"; break;
+		 case C_MACRO:
+			via = "At invocation of macro from"; break;
+		 case C_FUNCTION:
+			via = "At function invocation from"; break;
+		 case C_REP:
+			via = "At .rep block from"; break;
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,70 @@
+/*
+ * DebugMap.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef DEBUGMAP_H_
+#define DEBUGMAP_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/// Source locations of the instructions of a program, written by vc4asm -g.
+/// The file starts with a header followed by the ranges, the contexts, the files,
+/// the labels and the string table. All fields are 32 bit little endian.
+/// The ranges come first and are sorted by instruction index,
+/// so a tool may look up an instruction by binary search directly in the file.
+class DebugMap
+{public:
+	enum contextType : uint8_t
+	{	C_INCLUDE    ///< Source file
+	,	C_MACRO      ///< Macro invocation
+	,	C_FUNCTION   ///< Functional macro or function invocation
+	,	C_REP        ///< .rep block
+	};
+	/// Location within a context. The innermost context of an instruction is its source line,
+	/// the enclosing contexts are the invocations that produced it.
+	struct context
+	{	uint32_t       Parent;      ///< Contexts index + 1 of the enclosing context, 0: none
+		contextType    Type;
+		uint32_t       File;        ///< Files index
+		uint32_t       Line;
+	};
+	struct label
+	{	string         Name;
+		uint32_t       Value;       ///< Byte offset within the code
+	};
+	/// Consecutive instructions with the same source location.
+	struct range
+	{	uint32_t       Inst;        ///< Index of the first instruction
+		uint32_t       Context;     ///< Contexts index + 1 of the source line
+		uint32_t       Column;      ///< Column of the instruction or directive
+		uint32_t       Label;       ///< Labels index + 1 of the preceding label, 0: none
+	};
+	vector<string>   Files;
+	vector<context>  Contexts;
+	vector<label>    Labels;
+	vector<range>    Ranges;      ///< Ordered by Inst
+ private:
+	static const char Magic[4];
+	static const uint32_t Version = 1;
+ public:
+	/// Read a debug map.
+	/// @return false on error, errno is set in this case.
+	bool             Load(const char* path);
+	/// Write a debug map.
+	/// @return false on error, errno is set in this case.
+	bool             Save(const char* path) const;
+	/// Find the source location of an instruction in O(log n).
+	/// @return NULL if the instruction is not covered.
+	const range*     Find(uint32_t inst) const;
+	/// Format the location of a range like the messages of the assembler,
+	/// i.e. file (line,column) followed by the invocations on separate lines.
+	string           toString(const range& r) const;
+};
+
+#endif // DEBUGMAP_H_
@@ -315,6 +315,23 @@ void Disassembler::ScanLabels()
 	}
 }
 
+void Disassembler::PrintSource()
+{	uint32_t inst = (Addr - BaseAddr) / sizeof(uint64_t);
+	const DebugMap::range* r = Debug->Find(inst);
+	if (!r || r->Inst != inst || !r->Context)
+		return;
+	string loc = Debug->toString(*r);
+	if (r->Label)
+	{	const DebugMap::label& label = Debug->Labels[r->Label - 1];
+		loc = stringf("%s+%u: ", label.Name.c_str(), inst * (unsigned)sizeof(uint64_t) - label.Value) + loc;
+	}
+	// one comment line per context
+	size_t pos = 0;
+	while ((pos = loc.find('\n', pos)) != string::npos)
+		loc.replace(pos, 1, "\n\t#"), pos += 3;
+	fprintf(Out, "\t# %s\n", loc.c_str());
+}
+
 void Disassembler::Disassemble()
 {
 	Addr = BaseAddr;
@@ -324,6 +341,8 @@ void Disassembler::Disassemble()
 		auto l = Labels.find(Addr);
 		if (l != Labels.end())
 			fprintf(Out, ":%s\n", l->second.c_str());
+		if (Debug)
+			PrintSource();
 
 		DoInstruction();
 		*CodeAt = 0;
@@ -9,6 +9,7 @@
 #define DISASSEMBLER_H_
 
 #include "Inst.h"
+#include "DebugMap.h"
 
 #include <vector>
 #include <map>
@@ -25,6 +26,8 @@ class Disassembler
 	bool        PrintComment = false;
 	bool        PrintFields = false;
 	uint32_t    BaseAddr = 0;
+	/// Source locations to print as comment, optional.
+	const DebugMap* Debug = NULL;
 	vector<uint64_t> Instructions;
  private:
 	/// Mux accumulator names
@@ -79,6 +82,8 @@ class Disassembler
 	void DoLDI();
 	void DoBranch();
 	void DoInstruction();
+	/// Print the source location if a new one starts at the current instruction.
+	void PrintSource();
  public:
 	void ScanLabels();
 	void Disassemble();
@@ -0,0 +1,187 @@
+/*
+ * Elf.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Elf.h"
+
+#include <elf.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+
+// The host object uses the word size and byte order of the platform we are built for.
+#if UINTPTR_MAX > 0xffffffffU
+typedef Elf64_Ehdr elfEhdr;
+typedef Elf64_Shdr elfShdr;
+typedef Elf64_Sym  elfSym;
+#define ELF_CLASS ELFCLASS64
+#define ELF_ST_INFO ELF64_ST_INFO
+#else
+typedef Elf32_Ehdr elfEhdr;
+typedef Elf32_Shdr elfShdr;
+typedef Elf32_Sym  elfSym;
+#define ELF_CLASS ELFCLASS32
+#define ELF_ST_INFO ELF32_ST_INFO
+#endif
+
+#if defined(__x86_64__)
+#define ELF_MACHINE EM_X86_64
+#elif defined(__i386__)
+#define ELF_MACHINE EM_386
+#elif defined(__aarch64__)
+#define ELF_MACHINE EM_AARCH64
+#elif defined(__arm__)
+#define ELF_MACHINE EM_ARM
+// EABI version 5, the linker refuses to mix objects with different float ABIs.
+#ifdef __ARM_PCS_VFP
+#define ELF_FLAGS (0x05000000 | 0x400)
+#else
+#define ELF_FLAGS (0x05000000 | 0x200)
+#endif
+#else
+#define ELF_MACHINE EM_NONE
+#endif
+#ifndef ELF_FLAGS
+#define ELF_FLAGS 0
+#endif
+
+#if (defined(__BIG_ENDIAN__) && __BIG_ENDIAN__) || (defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN)
+#define ELF_DATA ELFDATA2MSB
+#else
+#define ELF_DATA ELFDATA2LSB
+#endif
+
+/// Section indices
+enum
+{	S_NULL
+,	S_RODATA
+,	S_GNUSTACK
+,	S_SYMTAB
+,	S_STRTAB
+,	S_SHSTRTAB
+,	S_COUNT
+};
+
+template <typename T>
+static void put(string& dst, const T& value)
+{	dst.append((const char*)&value, sizeof value);
+}
+
+static void align(string& dst, size_t alignment)
+{	dst.append(-dst.size() & (alignment - 1), '\0');
+}
+
+/// Append a name to a string table.
+/// @return Offset of the name.
+static uint32_t addName(string& table, const string& name)
+{	uint32_t pos = table.size();
+	table.append(name.c_str(), name.size() + 1);
+	return pos;
+}
+
+bool writeElf(const char* path, const string& name, const vector<uint64_t>& code)
+{	elfShdr sections[S_COUNT];
+	memset(sections, 0, sizeof sections);
+	string shstrtab(1, '\0');
+	string strtab(1, '\0');
+	string out(sizeof(elfEhdr), '\0');
+
+	// code, always little endian
+	align(out, 8);
+	elfShdr& rodata = sections[S_RODATA];
+	rodata.sh_name = addName(shstrtab, ".rodata");
+	rodata.sh_type = SHT_PROGBITS;
+	rodata.sh_flags = SHF_ALLOC;
+	rodata.sh_offset = out.size();
+	rodata.sh_size = code.size() * sizeof(uint64_t);
+	rodata.sh_addralign = 8;
+	for (uint64_t inst : code)
+		for (unsigned i = 0; i < 64; i += 8)
+			out.push_back((char)(inst >> i));
+
+	// no executable stack required
+	elfShdr& gnustack = sections[S_GNUSTACK];
+	gnustack.sh_name = addName(shstrtab, ".note.GNU-stack");
+	gnustack.sh_type = SHT_PROGBITS;
+	gnustack.sh_offset = out.size();
+	gnustack.sh_addralign = 1;
+
+	// symbols
+	align(out, 8);
+	elfShdr& symtab = sections[S_SYMTAB];
+	symtab.sh_name = addName(shstrtab, ".symtab");
+	symtab.sh_type = SHT_SYMTAB;
+	symtab.sh_offset = out.size();
+	symtab.sh_link = S_STRTAB;
+	symtab.sh_info = 2; // first global symbol
+	symtab.sh_addralign = 8;
+	symtab.sh_entsize = sizeof(elfSym);
+	elfSym sym;
+	memset(&sym, 0, sizeof sym);
+	put(out, sym);
+	sym.st_info = ELF_ST_INFO(STB_LOCAL, STT_SECTION);
+	sym.st_shndx = S_RODATA;
+	put(out, sym);
+	sym.st_name = addName(strtab, name + "_start");
+	sym.st_info = ELF_ST_INFO(STB_GLOBAL, STT_OBJECT);
+	sym.st_size = rodata.sh_size;
+	put(out, sym);
+	sym.st_name = addName(strtab, name + "_end");
+	sym.st_info = ELF_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+	sym.st_value = rodata.sh_size;
+	sym.st_size = 0;
+	put(out, sym);
+	sym.st_name = addName(strtab, name + "_size");
+	sym.st_shndx = SHN_ABS;
+	put(out, sym);
+	symtab.sh_size = out.size() - symtab.sh_offset;
+
+	elfShdr& str = sections[S_STRTAB];
+	str.sh_name = addName(shstrtab, ".strtab");
+	str.sh_type = SHT_STRTAB;
+	str.sh_offset = out.size();
+	str.sh_size = strtab.size();
+	str.sh_addralign = 1;
+	out.append(strtab);
+
+	elfShdr& shstr = sections[S_SHSTRTAB];
+	shstr.sh_name = addName(shstrtab, ".shstrtab");
+	shstr.sh_type = SHT_STRTAB;
+	shstr.sh_offset = out.size();
+	shstr.sh_size = shstrtab.size();
+	shstr.sh_addralign = 1;
+	out.append(shstrtab);
+
+	align(out, 8);
+	elfEhdr hdr;
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.e_ident, ELFMAG, SELFMAG);
+	hdr.e_ident[EI_CLASS] = ELF_CLASS;
+	hdr.e_ident[EI_DATA] = ELF_DATA;
+	hdr.e_ident[EI_VERSION] = EV_CURRENT;
+	hdr.e_type = ET_REL;
+	hdr.e_machine = ELF_MACHINE;
+	hdr.e_version = EV_CURRENT;
+	hdr.e_flags = ELF_FLAGS;
+	hdr.e_shoff = out.size();
+	hdr.e_ehsize = sizeof(elfEhdr);
+	hdr.e_shentsize = sizeof(elfShdr);
+	hdr.e_shnum = S_COUNT;
+	hdr.e_shstrndx = S_SHSTRTAB;
+	out.replace(0, sizeof hdr, (const char*)&hdr, sizeof hdr);
+	for (const elfShdr& section : sections)
+		put(out, section);
+
+	FILE* of = fopen(path, "wb");
+	if (!of)
+		return false;
+	bool ok = fwrite(out.data(), 1, out.size(), of) == out.size();
+	int err = errno;
+	ok &= fclose(of) == 0;
+	if (!ok)
+		errno = err;
+	return ok;
+}
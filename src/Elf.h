@@ -0,0 +1,24 @@
+/*
+ * Elf.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef ELF_H_
+#define ELF_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/// Write a relocatable ELF object for the host that embeds QPU code as data.
+/// The code is placed in .rodata, 8 byte aligned, in little endian byte order.
+/// The global symbols <name>_start, <name>_end and the absolute symbol <name>_size
+/// follow the convention of objcopy -I binary.
+/// The object matches the platform vc4asm has been built for.
+/// @return false on error, errno is set in this case.
+bool writeElf(const char* path, const string& name, const vector<uint64_t>& code);
+
+#endif // ELF_H_
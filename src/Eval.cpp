@@ -12,6 +12,7 @@
 #include <cmath>
 #include <cstdarg>
 #include <climits>
+#include <algorithm>
 
 
 Eval::Fail::Fail(const char* format, ...)
@@ -22,7 +23,16 @@ Eval::Fail::Fail(const char* format, ...)
 }
 
 
-Eval::operate::operate(vector<exprEntry>& stack)
+void Eval::stack::grow()
+{	exprEntry* data = new exprEntry[Capacity <<= 1];
+	copy(Data, Data + Size, data);
+	if (Data != Inline)
+		delete[] Data;
+	Data = data;
+}
+
+
+Eval::operate::operate(stack& stack)
 :	rhs(stack.back())
 ,	lhs(stack[stack.size()-2])
 ,	types((1 << rhs.Type) | ((lhs.Op & UNARY_OP) == 0) * (1 << lhs.Type))
@@ -126,11 +136,80 @@ int Eval::operate::Compare()
 	return ret;
 }
 
+bool Eval::operate::ApplyInt()
+{	switch (lhs.Op)
+	{default:
+		return false;
+	 case NOP:
+		lhs.iValue = rhs.iValue; break;
+	 case NEG:
+		lhs.iValue = -rhs.iValue; break;
+	 case NOT:
+		lhs.uValue = ~rhs.uValue; break;
+	 case lNOT:
+		lhs.uValue = !rhs.uValue; break;
+	 case MUL:
+		lhs.iValue *= rhs.iValue; break;
+	 case DIV:
+		lhs.iValue /= rhs.iValue; break;
+	 case MOD:
+		lhs.iValue %= rhs.iValue; break;
+	 case ADD:
+		lhs.uValue += rhs.uValue; break;
+	 case SUB:
+		lhs.uValue -= rhs.uValue; break;
+	 case ASL:
+		if (rhs.iValue < 0)
+			lhs.iValue >>= -rhs.iValue;
+		else
+			lhs.iValue <<= rhs.iValue;
+		break;
+	 case ASR:
+		if (rhs.iValue < 0)
+			lhs.iValue <<= -rhs.iValue;
+		else
+			lhs.iValue >>= rhs.iValue;
+		break;
+	 case SHL:
+		lhs.uValue <<= rhs.uValue; break;
+	 case SHR:
+		lhs.uValue >>= rhs.uValue; break;
+	 case GT:
+		lhs.iValue = lhs.iValue > rhs.iValue; break;
+	 case GE:
+		lhs.iValue = lhs.iValue >= rhs.iValue; break;
+	 case LT:
+		lhs.iValue = lhs.iValue < rhs.iValue; break;
+	 case LE:
+		lhs.iValue = lhs.iValue <= rhs.iValue; break;
+	 case EQ:
+		lhs.iValue = lhs.iValue == rhs.iValue; break;
+	 case NE:
+		lhs.iValue = lhs.iValue != rhs.iValue; break;
+	 case AND:
+		lhs.uValue &= rhs.uValue; break;
+	 case XOR:
+		lhs.uValue ^= rhs.uValue; break;
+	 case OR:
+		lhs.uValue |= rhs.uValue; break;
+	 case lAND:
+		lhs.iValue = lhs.uValue && rhs.uValue; break;
+	 case lOR:
+		lhs.iValue = lhs.uValue || rhs.uValue; break;
+	}
+	lhs.Type = V_INT;
+	lhs.Op = rhs.Op;
+	return true;
+}
+
 bool Eval::operate::Apply(bool unary)
 {	if ( (lhs.Op & PRECEDENCE) < (rhs.Op & PRECEDENCE)
 		|| (unary && !(lhs.Op & UNARY_OP)) )
 		return true;
 
+	if (types == 1<<V_INT && ApplyInt())
+		return false;
+
 	switch (lhs.Op)
 	{default:
 		throw Fail("internal parser error");
@@ -61,11 +61,33 @@ class Eval
 		exprEntry() : Op(NOP) {}
 		//constexpr exprEntry(const exprValue& r) : exprValue(r), Op(&nopOperator) {}
 	};
-	vector<exprEntry> Stack;
+	/// Operand stack with inline storage for typical expressions.
+	/// Only deeply nested expressions allocate memory.
+	class stack
+	{	enum { INLINE = 16 };
+		exprEntry* Data;
+		size_t    Size = 0;
+		size_t    Capacity = INLINE;
+		exprEntry Inline[INLINE];
+		void      grow();
+	 public:
+		stack() : Data(Inline) {}
+		stack(const stack&) = delete;
+		~stack()  { if (Data != Inline) delete[] Data; }
+		size_t    size() const                { return Size; }
+		exprEntry& operator[](size_t i)       { return Data[i]; }
+		exprEntry& front()                    { return Data[0]; }
+		exprEntry& back()                     { return Data[Size-1]; }
+		void      emplace_back()              { if (Size == Capacity) grow(); Data[Size++] = exprEntry(); }
+		void      pop_back()                  { --Size; }
+	}           Stack;
 	class operate
 	{	exprEntry& rhs;
 		exprEntry& lhs;
 		unsigned  types;
+		/// Fast path for integer operands.
+		/// @return false if the operator is not handled here.
+		bool      ApplyInt();
 		void      TypesFail();
 		void      CheckInt();
 		void      CheckBool();
@@ -73,7 +95,7 @@ class Eval
 		void      CheckNumericPropFloat();
 		int       Compare();
 	 public:
-		operate(vector<exprEntry>& stack);
+		operate(stack& stack);
 		bool      Apply(bool unary);
 	};
  private:
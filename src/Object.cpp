@@ -0,0 +1,122 @@
+/*
+ * Object.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Object.h"
+
+#include <cstdio>
+#include <cerrno>
+
+
+const char Object::Magic[4] = { 'V','C','4','O' };
+
+static void put32(string& dst, uint32_t value)
+{	for (unsigned i = 0; i < 32; i += 8)
+		dst.push_back((char)(value >> i));
+}
+
+static uint32_t get32(const char*& cp)
+{	uint32_t value = 0;
+	for (unsigned i = 0; i < 32; i += 8)
+		value |= (uint32_t)(uint8_t)*cp++ << i;
+	return value;
+}
+
+bool Object::Save(const char* path) const
+{	string strings;
+	string out(Magic, sizeof Magic);
+	put32(out, Version);
+	put32(out, Code.size());
+	put32(out, Symbols.size());
+	put32(out, Relocs.size());
+	size_t sizepos = out.size();
+	put32(out, 0); // size of the string table, see below
+	for (uint64_t inst : Code)
+	{	put32(out, (uint32_t)inst);
+		put32(out, (uint32_t)(inst >> 32));
+	}
+	for (const symbol& sym : Symbols)
+	{	put32(out, strings.size());
+		put32(out, sym.Value);
+		put32(out, sym.Defined);
+		strings.append(sym.Name.c_str(), sym.Name.size() + 1);
+	}
+	for (const relocation& rel : Relocs)
+	{	put32(out, rel.Inst);
+		put32(out, rel.Symbol);
+		put32(out, rel.Type);
+	}
+	string size;
+	put32(size, strings.size());
+	out.replace(sizepos, size.size(), size);
+	out.append(strings);
+
+	FILE* of = fopen(path, "wb");
+	if (!of)
+		return false;
+	bool ok = fwrite(out.data(), 1, out.size(), of) == out.size();
+	int err = errno;
+	ok &= fclose(of) == 0;
+	if (!ok)
+		errno = err;
+	return ok;
+}
+
+bool Object::Load(const char* path)
+{	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+	string data;
+	char buf[4096];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof buf, f)) != 0)
+		data.append(buf, len);
+	bool ok = !ferror(f);
+	fclose(f);
+	if (!ok)
+	{	errno = EIO;
+		return false;
+	}
+
+	errno = EINVAL;
+	if (data.size() < 24 || data.compare(0, sizeof Magic, Magic, sizeof Magic) != 0)
+		return false;
+	const char* cp = data.data() + sizeof Magic;
+	if (get32(cp) != Version)
+		return false;
+	uint64_t count = get32(cp);
+	uint64_t symbols = get32(cp);
+	uint64_t relocs = get32(cp);
+	uint64_t stringsize = get32(cp);
+	if (data.size() != 24 + count * 8 + (symbols + relocs) * 12 + stringsize
+		|| (stringsize && data.back() != 0))
+		return false;
+	const char* strings = data.data() + data.size() - stringsize;
+
+	Code.resize(count);
+	for (uint64_t& inst : Code)
+	{	inst = get32(cp);
+		inst |= (uint64_t)get32(cp) << 32;
+	}
+	Symbols.resize(symbols);
+	for (symbol& sym : Symbols)
+	{	uint32_t name = get32(cp);
+		if (name >= stringsize)
+			return false;
+		sym.Name = strings + name;
+		sym.Value = get32(cp);
+		sym.Defined = get32(cp) != 0;
+	}
+	Relocs.resize(relocs);
+	for (relocation& rel : Relocs)
+	{	rel.Inst = get32(cp);
+		rel.Symbol = get32(cp);
+		uint32_t type = get32(cp);
+		if (rel.Inst >= count || rel.Symbol > symbols || type > R_REL)
+			return false;
+		rel.Type = (relocType)type;
+	}
+	return true;
+}
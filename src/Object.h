@@ -0,0 +1,54 @@
+/*
+ * Object.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef OBJECT_H_
+#define OBJECT_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/// Relocatable object written by vc4asm -r and linked by vc4ld.
+/// The file starts with a header followed by the code, the symbols, the relocations
+/// and the string table with the symbol names. All fields are little endian.
+class Object
+{public:
+	/// Label exported or imported by an object.
+	struct symbol
+	{	string         Name;
+		uint32_t       Value;       ///< Byte offset within the code of the object, 0 for imports
+		bool           Defined;     ///< false: import, resolved by the linker
+	};
+	enum relocType : uint8_t
+	{	R_ABS  ///< Add the address of the target including the base address, e.g. ldi or bra
+	,	R_REL  ///< Add the offset of the target from the start of the object, brr
+	};
+	/// The 32 bit immediate value of an instruction that depends on the location of the code.
+	struct relocation
+	{	uint32_t       Inst;        ///< Instruction index
+		uint32_t       Symbol;      ///< Symbols index + 1 of the target, 0: start of the object
+		relocType      Type;
+	};
+	vector<uint64_t> Code;
+	vector<symbol>   Symbols;
+	vector<relocation> Relocs;
+ private:
+	static const char Magic[4];
+	static const uint32_t Version = 1;
+ public:
+	/// Read an object file.
+	/// @return false on error, errno is set in this case.
+	bool             Load(const char* path);
+	/// Write an object file.
+	/// @return false on error, errno is set in this case.
+	bool             Save(const char* path) const;
+	/// Add a value to the immediate value of an instruction.
+	static void      Patch(uint64_t& inst, uint32_t value) { inst = (inst & 0xffffffff00000000ULL) | (uint32_t)(inst + value); }
+};
+
+#endif // OBJECT_H_
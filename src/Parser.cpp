@@ -6,6 +6,9 @@
  */
 
 #include "Parser.h"
+#include "Object.h"
+#include "DebugMap.h"
+#include "phash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
@@ -15,79 +18,180 @@
 
 
 string Parser::location::toString() const
-{	return stringf("%s (%u)", File.c_str(), Line);
+{	return stringf("%s (%u)", FileNames.Name(File).c_str(), Line);
 }
 
 
-Parser::saveContext::saveContext(Parser& parent, fileContext* ctx)
+Parser::saveContext::saveContext(Parser& parent, contextType type, ident file, unsigned line)
 :	Parent(parent)
-{	parent.Context.emplace_back(ctx);
+{	auto& pool = parent.FreeContexts;
+	if (pool.size())
+	{	fileContext& ctx = *pool.back();
+		ctx.Type = type;
+		ctx.File = file;
+		ctx.Line = line;
+		parent.Context.push_back(move(pool.back()));
+		pool.pop_back();
+	} else
+		parent.Context.emplace_back(new fileContext(type, file, line));
+	parent.Context.back()->Level = parent.Context.size() - 1;
 }
 
 Parser::saveContext::~saveContext()
-{	Parent.Context.pop_back();
-}
-
-Parser::saveLineContext::saveLineContext(Parser& parent, fileContext* ctx)
-:	saveContext(parent, ctx)
+{	// Hide the constants of the context. They are always the innermost bindings.
+	fileContext& ctx = *Parent.Context.back();
+	for (const auto& c : ctx.Consts)
+		if (c.Name)
+			Parent.Symbols.find(c.Name)->second.pop_back();
+	ctx.Consts.clear();
+	ctx.Args.clear();
+	Parent.FreeContexts.push_back(move(Parent.Context.back()));
+	Parent.Context.pop_back();
+}
+
+Parser::saveLineContext::saveLineContext(Parser& parent, contextType type, ident file, unsigned line)
+:	saveContext(parent, type, file, line)
 , LineBak(parent.Line)
 , AtBak(parent.At)
+, TokenAtBak(parent.TokenAt)
+, LineTokensBak(parent.LineTokens)
 {}
 
 Parser::saveLineContext::~saveLineContext()
-{	strncpy(Parent.Line, LineBak.c_str(), sizeof(Line));
+{	Parent.Line = LineBak;
 	Parent.At = AtBak;
+	Parent.TokenAt = TokenAtBak;
+	Parent.LineTokens = LineTokensBak;
+}
+
+
+void Parser::lineBuffer::append(const char* line, const token* tokens, const vector<ident>& args)
+{	Lines.push_back({(unsigned)Text.size(), (unsigned)Tokens.size()});
+	if (tokens->Type == END)
+	{	// Empty line or comment
+		Text.push_back('\n');
+		Tokens.push_back({END, 0, 0, 0, 0});
+		return;
+	}
+	const token* end = tokens;
+	while (end->Type != END)
+		++end;
+	Text.append(line, end->Pos);
+	Text.push_back('\n');
+	do
+	{	token tok = *tokens;
+		tok.Arg = 0;
+		if (tok.Type == WORD)
+			for (size_t i = 0; i < args.size() && i < 255; ++i)
+				if (args[i] == tok.Id)
+				{	tok.Arg = i + 1;
+					break;
+				}
+		Tokens.push_back(tok);
+	} while (tokens++->Type != END);
 }
 
 
+void Parser::appendContext(string& msg, contextType type, const string& file, unsigned line, unsigned column)
+{	switch (type)
+	{case CTX_CURRENT:
+		msg = stringf("%s (%u,%u): ", file.c_str(), line, column) + msg;
+		break;
+	 case CTX_INCLUDE:
+		msg += stringf("\n  Included from %s (%u)", file.c_str(), line);
+		break;
+	 case CTX_MACRO:
+	 case CTX_REP:
+		msg += stringf("\n  At invocation of macro from %s (%u)", file.c_str(), line);
+		break;
+	 case CTX_FUNCTION:
+		msg += stringf("\n  At function invocation from %s (%u)", file.c_str(), line);
+		break;
+	 case CTX_ROOT:;
+	}
+}
+
 string Parser::enrichMsg(string msg)
 {	// Show context
 	contextType type = CTX_CURRENT;
 	for (auto i = Context.rbegin(); i != Context.rend(); ++i)
 	{	const fileContext& ctx = **i;
 		if (ctx.Line)
-			switch (type)
-			{case CTX_CURRENT:
-				msg = stringf("%s (%u,%u): ", ctx.File.c_str(), ctx.Line, At - Line - Token.size() + 1) + msg;
-				break;
-			 case CTX_INCLUDE:
-				msg += stringf("\n  Included from %s (%u)", ctx.File.c_str(), ctx.Line);
-				break;
-			 case CTX_MACRO:
-				msg += stringf("\n  At invocation of macro from %s (%u)", ctx.File.c_str(), ctx.Line);
-				break;
-			 case CTX_FUNCTION:
-				msg += stringf("\n  At function invocation from %s (%u)", ctx.File.c_str(), ctx.Line);
-				break;
-			 case CTX_ROOT:;
-			}
+			appendContext(msg, type, FileNames.Name(ctx.File), ctx.Line, column());
 		type = ctx.Type;
 	}
 	return msg;
 }
 
+unsigned Parser::captureChain(vector<chainEntry>& chains, vector<unsigned>& last) const
+{	unsigned parent = 0;
+	for (size_t i = 0; i < Context.size(); ++i)
+	{	const fileContext& ctx = *Context[i];
+		// Share the entries of the last snapshot as long as the contexts did not change.
+		if (i < last.size())
+		{	const chainEntry& e = chains[last[i] - 1];
+			if (e.Parent == parent && e.Type == ctx.Type && e.Line == ctx.Line && e.File == ctx.File)
+			{	parent = last[i];
+				continue;
+			}
+			last.resize(i);
+		}
+		chains.push_back(chainEntry{parent, ctx.Type, ctx.Line, ctx.File});
+		parent = chains.size();
+		last.push_back(parent);
+	}
+	return parent;
+}
+
+string Parser::renderMsg(const diagnostic& diag) const
+{	string msg = formatArgs(diag.Format, diag.Args);
+	contextType type = CTX_CURRENT;
+	for (unsigned i = diag.Chain; i; i = Chains[i-1].Parent)
+	{	const chainEntry& e = Chains[i-1];
+		if (e.Line)
+			appendContext(msg, type, FileNames.Name(e.File), e.Line, diag.Column);
+		type = e.Type;
+	}
+	return msg;
+}
+
 void Parser::Fail(const char* fmt, ...)
-{	Success = false;
+{	if (Combining)
+		throw combineConflict(); // the caller retries without combining
+	Success = false;
 	va_list va;
 	va_start(va, fmt);
 	throw enrichMsg(vstringf(fmt, va));
 	va_end(va);
 }
 
-static const char msgpfx[][10]
+const char Parser::MsgPrefix[][10]
 {	"ERROR: "
 ,	"Warning: "
 ,	"Info: "
 };
 
 void Parser::Msg(severity level, const char* fmt, ...)
-{	if (!Pass2 || Verbose < level)
+{	if (Verbose < level)
 		return;
+	// The diagnostic must not get lost by memoizing the current invocation.
+	impure();
 	va_list va;
 	va_start(va, fmt);
-	fputs(msgpfx[level], stderr);
-	fputs(enrichMsg(vstringf(fmt, va)).c_str(), stderr);
+	if (!Pass2 || Combining)
+		// Defer until we know whether pass 2 is required or whether the combine attempt succeeds.
+		// Only the arguments are saved, most deferred messages are discarded.
+		Messages.push_back(diagnostic{level, fmt, packArgs(fmt, va), captureChain(), column()});
+	else
+		emitMsg(level, enrichMsg(vstringf(fmt, va)));
 	va_end(va);
+}
+
+void Parser::emitMsg(severity level, const string& msg)
+{	if (OnMessage)
+		return OnMessage(level, msg);
+	fputs(MsgPrefix[level], stderr);
+	fputs(msg.c_str(), stderr);
 	fputc('\n', stderr);
 }
 
@@ -98,68 +202,217 @@ void Parser::FlagsSize(size_t min)
 
 void Parser::StoreInstruction(uint64_t inst)
 {
-	for (unsigned i = Back; i--;)
-		Instructions[PC+i+1] = Instructions[PC+i];
+	if (Back)
+	{	for (unsigned i = Back; i--;)
+		{	Instructions[PC+i+1] = Instructions[PC+i];
+			InstFlags[PC+i+1] = (InstFlags[PC+i+1] & ~IF_ABSOLUTE) | (InstFlags[PC+i] & IF_ABSOLUTE);
+		}
+		for (auto& f : Fixups)
+			if (f.Inst >= PC && f.Inst < PC + Back)
+				++f.Inst;
+	}
+	if (DebugInfo)
+	{	if (DebugLines.size() <= PC + Back)
+			DebugLines.resize(PC + Back + 1);
+		for (unsigned i = Back; i--;)
+			DebugLines[PC+i+1] = DebugLines[PC+i];
+		DebugLines[PC] = {captureChain(DebugChains, DebugLast), InstColumn, LastLabel};
+	}
+	if (FixupLabel)
+	{	Fixups.push_back({PC, FixupLabel - 1});
+		FixupLabel = 0;
+	}
+	InstFlags[PC] = (InstFlags[PC] & ~IF_ABSOLUTE) | (AbsLabel ? IF_ABSOLUTE : IF_NONE);
+	AbsLabel = false;
 	Instructions[PC++] = inst;
 }
 
-Parser::token_t Parser::NextToken()
-{
-	At += strspn(At, " \t\r\n");
-
-	switch (*At)
-	{case 0:
-	 case '#':
-		Token.clear();
-		return END;
-	 case '*':
-	 case '>':
-	 case '<':
-	 case '&':
-	 case '^':
-	 case '|':
-		if (At[1] == At[0])
-		{	if (At[2] == At[1])
-			{	Token.assign(At, 3);
-				At += 3;
-				return OP;
+Parser::identPool::identPool()
+:	Count(0)
+{	for (auto& block : Blocks)
+		block.store(NULL, memory_order_relaxed);
+	Intern("", 0);
+}
+
+Parser::identPool::~identPool()
+{	for (auto& block : Blocks)
+		delete[] block.load(memory_order_relaxed);
+}
+
+void Parser::identPool::publish(ident id, const string* name)
+{	if (id >> BlockBits >= BlockCount)
+		throw string("Too many identifiers.");
+	atomic<slot*>& block = Blocks[id >> BlockBits];
+	slot* slots = block.load(memory_order_acquire);
+	if (!slots)
+	{	// Another shard might allocate the same block meanwhile.
+		slot* created = new slot[1 << BlockBits];
+		if (block.compare_exchange_strong(slots, created, memory_order_acq_rel))
+			slots = created;
+		else
+			delete[] created;
+	}
+	slots[id & ((1 << BlockBits) - 1)].store(name, memory_order_release);
+}
+
+Parser::ident Parser::identPool::Intern(const char* name, size_t len)
+{	shard& sh = Shards[hash64(name, len) % ShardCount];
+	lock_guard<mutex> lock(sh.Lock);
+	sh.Key.assign(name, len);
+	auto it = sh.Ids.find(sh.Key);
+	if (it != sh.Ids.end())
+		return it->second;
+	it = sh.Ids.emplace(sh.Key, Count.fetch_add(1, memory_order_relaxed)).first;
+	publish(it->second, &it->first);
+	return it->second;
+}
+
+void Parser::identPool::Compact(const vector<bool>& used, vector<ident>& remap)
+{	ident count = Size();
+	remap.assign(count, 0);
+	ident next = 0;
+	for (ident id = 0; id < count; ++id)
+		if (id < used.size() && used[id])
+			remap[id] = next++;
+	for (shard& sh : Shards)
+		for (auto it = sh.Ids.begin(); it != sh.Ids.end();)
+			if (it->second < used.size() && used[it->second])
+			{	it->second = remap[it->second];
+				publish(it->second, &it->first);
+				++it;
+			} else
+				it = sh.Ids.erase(it);
+	for (ident id = next; id < count; ++id)
+		publish(id, NULL);
+	Count.store(next, memory_order_relaxed);
+}
+
+Parser::identPool Parser::Idents;
+Parser::identPool Parser::FileNames;
+const Parser::ident Parser::RepMacro = Parser::Idents.Intern(".rep");
+Parser::ident Parser::LiveIdents = 0;
+
+void Parser::CollectIdents()
+{	// Amortize the scan of all cached tokens.
+	if (Idents.Size() < 2 * LiveIdents + 4096)
+		return;
+	vector<bool> used(Idents.Size());
+	for (ident id = 0; id <= RepMacro; ++id)
+		used[id] = true;
+	lock_guard<mutex> lock(SourceCache.Lock);
+	for (const auto& entry : SourceCache.Files)
+		for (const token& tok : entry.second->Tokens)
+			used[tok.Id] = true;
+	vector<ident> remap;
+	Idents.Compact(used, remap);
+	for (auto& entry : SourceCache.Files)
+		// No parser is active, so nobody else sees the tokens meanwhile.
+		for (token& tok : const_cast<sourceFile&>(*entry.second).Tokens)
+			tok.Id = remap[tok.Id];
+	LiveIdents = Idents.Size();
+	// File ids are only used while parsing.
+	FileNames.Compact(vector<bool>(1, true), remap);
+}
+
+void Parser::Tokenize(const char* line, tokens_t& dst)
+{	const char* cp = line;
+	token tok;
+	do
+	{	cp += strspn(cp, " \t\r");
+		tok.Arg = 0;
+		tok.Id = 0;
+		tok.Pos = cp - line;
+		switch (*cp)
+		{case '\n':
+			// The end of line is behind the line feed like the column of messages always was.
+			++tok.Pos;
+		 case 0:
+		 case '#':
+			tok.Type = END;
+			tok.Len = 0;
+			break;
+		 case '*':
+		 case '>':
+		 case '<':
+		 case '&':
+		 case '^':
+		 case '|':
+			if (cp[1] == cp[0])
+			{	if (cp[2] == cp[1])
+				{	tok.Type = OP;
+					tok.Len = 3;
+					break;
+				}
+			 op2:
+				tok.Type = OP;
+				tok.Len = 2;
+				break;
+			}
+		 case '!':
+		 case '=':
+			if (cp[1] == '=')
+				goto op2;
+		 case '+':
+		 case '-':
+		 case '/':
+		 case '%':
+		 case '~':
+			tok.Type = OP;
+			tok.Len = 1;
+			break;
+		 case '(':
+		 case ')':
+		 case '[':
+		 case ']':
+		 case '.':
+		 case ',':
+		 case ';':
+		 case ':':
+			tok.Type = (token_t)*cp;
+			tok.Len = 1;
+			break;
+		 default:
+			if (isdigit(*cp))
+			{	tok.Type = NUM;
+				tok.Len = strspn(cp, "0123456789abcdefABCDEFx."); // read until we don't find a hex digit, x (for hex) or .
+			} else
+			{	tok.Type = WORD;
+				tok.Len = strcspn(cp, ".,;:+-*/%()&|^~!=<> \t\r\n");
+				tok.Id = Idents.Intern(cp, tok.Len);
 			}
-		 op2:
-			Token.assign(At, 2);
-			At += 2;
-			return OP;
 		}
-	 case '!':
-	 case '=':
-		if (At[1] == '=')
-			goto op2;
-	 case '+':
-	 case '-':
-	 case '/':
-	 case '%':
-	 case '~':
-		Token.assign(At, 1);
-		++At;
-		return OP;
-	 case '(':
-	 case ')':
-	 case '[':
-	 case ']':
-	 case '.':
-	 case ',':
-	 case ';':
-	 case ':':
-		Token.assign(At, 1);
-		return (token_t)*At++;
-	}
-
-	size_t i = isdigit(*At)
-		?	strspn(At, "0123456789abcdefABCDEFx.") // read until we don't find a hex digit, x (for hex) or .
-		:	strcspn(At, ".,;:+-*/%()&|^~!=<> \t\r\n");
-	Token.assign(At, i);
-	At += i;
-
-	return isdigit(Token[0]) ? NUM : WORD;
+		dst.push_back(tok);
+		cp += tok.Len;
+	} while (tok.Type != END);
+}
+
+void Parser::setLine(const lineBuffer& buffer, const sourceLine& line)
+{	At = Line = buffer.text() + line.Text;
+	LineTokens = TokenAt = &buffer.Tokens[line.Tokens];
+}
+
+Parser::token_t Parser::NextToken()
+{	const token& tok = *TokenAt;
+	if (tok.Type != END)
+		++TokenAt;
+	Token.assign(Line + tok.Pos, tok.Len);
+	TokenId = tok.Id;
+	At = Line + tok.Pos + tok.Len;
+	return tok.Type;
+}
+
+const char* Parser::lineEnd() const
+{	const token* tok = TokenAt;
+	while (tok->Type != END)
+		++tok;
+	return Line + tok->Pos;
+}
+
+void Parser::pushBack()
+{	// Only END has an empty token text and END is never passed.
+	if (Token.size())
+		--TokenAt;
+	At -= Token.size();
 }
 
 size_t Parser::parseUInt(const char* src, uint32_t& dst)
@@ -194,6 +447,26 @@ size_t Parser::parseUInt(const char* src, uint32_t& dst)
 	return cp - src;
 }
 
+bool Parser::parseNumber(const string& text, exprValue& value)
+{	if (text.find('.') == string::npos)
+	{	// integer
+		//size_t len;  sscanf of gcc4.8.2/Linux x32 can't read "0x80000000".
+		//if (sscanf(Token.c_str(), "%i%n", &stack.front().iValue, &len) != 1 || len != Token.size())
+		value.Type = V_INT;
+		return parseUInt(text.c_str(), value.uValue) == text.size();
+	} else
+	{	// float number
+		int len;
+		value.Type = V_FLOAT;
+		return sscanf(text.c_str(), "%f%n", &value.fValue, &len) == 1 && (size_t)len == text.size();
+	}
+}
+
+const Parser::regEntry* Parser::findRegister(const char* name)
+{	static const perfect_hash<decltype(regMap)> regIndex(regMap);
+	return regIndex.find(name);
+}
+
 exprValue Parser::parseElemInt()
 {	uint32_t value = 0;
 	int pos = 0;
@@ -247,25 +520,36 @@ exprValue Parser::parseElemInt()
 	return exprValue(value, (valueType)(sign + V_LDPE));
 }
 
-exprValue Parser::ParseExpression()
+exprValue Parser::ParseExpression(unsigned* fixup)
 {
 	Eval eval;
 	exprValue value;
+	unsigned labels = 0; // number of label references
+	unsigned undefined = 0; // label index + 1 of the last undefined label reference in pass 1
+	const constDef* cdef;
 	try
 	{next:
 		switch (NextToken())
 		{case WORD:
+			{	// Macro argument?
+				const auto& args = Context.back()->Args;
+				unsigned arg = TokenAt[-1].Arg;
+				if (arg && arg <= args.size() && args[arg-1])
+				{	cdef = args[arg-1];
+					goto have_const;
+				}
+			}
 			{	// Expand constants
-				for (auto i = Context.end(); i != Context.begin(); )
-				{	auto c = (*--i)->Consts.find(Token);
-					if (c != (*i)->Consts.end())
-					{	value = c->second.Value;
-						goto have_value;
-					}
+				auto s = Symbols.find(TokenId);
+				if (s != Symbols.end() && s->second.size())
+				{	trackRead(TokenId, &s->second.back());
+					cdef = s->second.back().Def;
+					goto have_const;
 				}
+				trackRead(TokenId, NULL);
 			}
 			{	// try function
-				auto fp = Functions.find(Token);
+				auto fp = Functions.find(TokenId);
 				if (fp != Functions.end())
 				{	// Hit!
 					value = doFUNC(fp);
@@ -273,25 +557,25 @@ exprValue Parser::ParseExpression()
 				}
 			}
 			{	// try functional macro
-				auto mp = MacroFuncs.find(Token);
+				auto mp = MacroFuncs.find(TokenId);
 				if (mp != MacroFuncs.end())
 				{	value = doFUNCMACRO(mp);
 					break;
 				}
 			}
 			{	// try register
-				const regEntry* rp = binary_search(regMap, Token.c_str());
+				const regEntry* rp = findRegister(Token.c_str());
 				if (rp)
 				{	value = rp->Value;
 					break;
 				}
 			}
 			// Try label prefix
-			{	string identifier = Token;
+			{	ident identifier = TokenId;
 				if (NextToken() != COLON)
-					Fail("Invalid expression. The identifier %s did not evaluate.", identifier.c_str());
-				if (identifier != "r")
-					Fail("'%s:' is no valid label prefix.", identifier.c_str());
+					Fail("Invalid expression. The identifier %s did not evaluate.", Idents.Name(identifier).c_str());
+				if (Idents.Name(identifier) != "r")
+					Fail("'%s:' is no valid label prefix.", Idents.Name(identifier).c_str());
 			}
 		 case COLON: // Label
 			{	// Is forward reference?
@@ -337,7 +621,9 @@ exprValue Parser::ParseExpression()
 					}
 				 case WORD:;
 				}
-				const auto& l = LabelsByName.emplace(Token, LabelCount);
+				// The value of a label may change in pass 2.
+				impure();
+				const auto& l = LabelsByName.emplace(tokenId(), LabelCount);
 				if (l.second || (forward && Labels[l.first->second].Definition))
 				{	// new label
 					l.first->second = LabelCount;
@@ -348,14 +634,35 @@ exprValue Parser::ParseExpression()
 					Labels[LabelCount].Reference = *Context.back();
 					++LabelCount;
 				}
-				value = exprValue(Labels[l.first->second].Value, V_LABEL);
+				const label& lbl = Labels[l.first->second];
+				++labels;
+				if (!lbl.Definition && (!Pass2 || lbl.Import))
+					undefined = l.first->second + 1;
+				value = exprValue(lbl.Value, V_LABEL);
 				break;
 			}
 
 		 default:
 		 discard:
-			At -= Token.size();
-			return eval.Evaluate();
+			pushBack();
+			value = eval.Evaluate();
+			if (fixup)
+				*fixup = 0;
+			if (undefined)
+			{	// The value of an undefined label is not yet known.
+				if (fixup && labels == 1 && value.Type == V_LABEL)
+					*fixup = undefined;
+				else if (Pass2)
+				{	// Only imports are undefined in pass 2.
+					// Not Fail, the handler below adds the location.
+					Success = false;
+					throw stringf("The imported label %s can only be used as branch target or immediate value, optionally plus a constant.",
+						Labels[undefined - 1].Name.c_str());
+				}
+				else
+					NeedPass2 = true;
+			}
+			return value;
 
 		 case OP:
 		 case BRACE1:
@@ -373,27 +680,29 @@ exprValue Parser::ParseExpression()
 
 		 case NUM:
 			// parse number
-			if (Token.find('.') == string::npos)
-			{	// integer
-				//size_t len;  sscanf of gcc4.8.2/Linux x32 can't read "0x80000000".
-				//if (sscanf(Token.c_str(), "%i%n", &stack.front().iValue, &len) != 1 || len != Token.size())
-				if (parseUInt(Token.c_str(), value.uValue) != Token.size())
-					Fail("%s is no integral number.", Token.c_str());
-				value.Type = V_INT;
-			} else
-			{	// float number
-				size_t len;
-				if (sscanf(Token.c_str(), "%f%n", &value.fValue, &len) != 1 || len != Token.size())
-					Fail("%s is no real number.", Token.c_str());
-				value.Type = V_FLOAT;
-			}
+			if (!parseNumber(Token, value))
+				Fail(value.Type == V_INT ? "%s is no integral number." : "%s is no real number.", Token.c_str());
 			break;
 		}
 	 have_value:
 		eval.PushValue(value);
 		goto next;
+	 have_const:
+		value = cdef->Value;
+		if (cdef->Fixup)
+		{	// Constant depends on a forward reference
+			const label& lbl = Labels[cdef->Fixup - 1];
+			++labels;
+			if (lbl.Definition)
+				value.uValue += lbl.Value;
+			else
+				undefined = cdef->Fixup;
+		}
+		goto have_value;
 	} catch (const string& msg)
-	{	throw enrichMsg(msg);
+	{	if (Combining)
+			throw combineConflict();
+		throw enrichMsg(msg);
 	}
 }
 
@@ -545,7 +854,8 @@ void Parser::doInstrExt(InstContext ctx)
 	{	if (NextToken() != WORD)
 			Fail("Expected instruction extension after dot.");
 
-		const opExtEntry* ep = binary_search(extMap, Token.c_str());
+		static const perfect_hash<decltype(extMap)> extIndex(extMap);
+		const opExtEntry* ep = extIndex.find(Token.c_str());
 		if (!ep)
 		 fail:
 			Fail("Unknown instruction extension '%s' within this context.", Token.c_str());
@@ -555,7 +865,7 @@ void Parser::doInstrExt(InstContext ctx)
 				goto fail;
 		(this->*(ep->Func))(ep->Arg, ctx);
 	}
-	At -= Token.size();
+	pushBack();
 }
 
 void Parser::doALUTarget(exprValue param, bool mul)
@@ -638,7 +948,7 @@ Inst::mux Parser::doALUExpr(InstContext ctx)
 	doInstrExt(ctx);
 }
 
-void Parser::doBRASource(exprValue param)
+void Parser::doBRASource(exprValue param, unsigned fixup)
 {
 	switch (param.Type)
 	{default:
@@ -647,11 +957,23 @@ void Parser::doBRASource(exprValue param)
 		if (Instruct.Rel)
 			param.uValue -= (PC + 4) * sizeof(uint64_t);
 		else
-			Msg(WARNING, "Using value of label as target of a absolute branch instruction.");
+		{	AbsLabel = true;
+			// Only relocatable or position independent code gets the real address later.
+			if (!Relocatable && !PositionIndependent)
+				Msg(WARNING, "Using value of label as target of a absolute branch instruction.");
+		}
+		if (fixup)
+		{	// Forward reference, the label value is added when the instruction is stored.
+			if (Instruct.Immd.uValue || FixupLabel)
+				Fail("Cannot specify two immediate values as branch target.");
+			Instruct.Immd = param;
+			FixupLabel = fixup;
+			break;
+		}
 	 case V_INT:
 		if (!param.uValue)
 			return;
-		if (Instruct.Immd.uValue)
+		if (Instruct.Immd.uValue || FixupLabel)
 			Fail("Cannot specify two immediate values as branch target.");
 		Instruct.Immd = param;
 		break;
@@ -753,10 +1075,26 @@ void Parser::assembleMOV(int mode)
 
 	if (NextToken() != COMMA)
 		Fail("Expected ', <source1>' after first argument to ALU instruction, found %s.", Token.c_str());
-	exprValue param = ParseExpression();
+	unsigned fixup;
+	exprValue param = ParseExpression(&fixup);
+	// Label of a forward reference in the immediate value loaded so far
+	unsigned pending = FixupLabel;
 	switch (param.Type)
 	{default:
 		Fail("The last parameter of a MOV instruction must be a register or a immediate value. Found %s", type2string(param.Type));
+	 case V_LABEL:
+		// Code addresses are always loaded by ldi to keep them relocatable.
+		if (mode > Inst::L_LDI)
+			Fail("Load immediate mode conflicts with label value.");
+		mode = Inst::L_LDI;
+		AbsLabel = true;
+		if (fixup)
+		{	// Forward reference, the label value is added when the instruction is stored.
+			if (FixupLabel && FixupLabel != fixup)
+				Fail("Cannot load two labels in one instruction.");
+			FixupLabel = fixup;
+		}
+		break;
 	 case V_REG:
 		if (param.rValue.Type & R_SEMA)
 		{	// semaphore access by LDI like instruction
@@ -839,6 +1177,9 @@ void Parser::assembleMOV(int mode)
 	{default:
 		Fail("Load immediate cannot be used with signals.");
 	 case Inst::S_LDI:
+		// The value of a forward reference is not yet known, so it only matches the same label.
+		if (pending != (param.Type == V_LABEL ? fixup : 0))
+			Fail("Cannot load a label that is not yet defined and another value in one instruction.");
 		if (Instruct.Immd.uValue != param.uValue || Instruct.LdMode != mode)
 			Fail("Tried to load two different immediate values in one instruction. (0x%x vs. 0x%x)", Instruct.Immd.uValue, param.uValue);
 	 case Inst::S_NONE:;
@@ -869,33 +1210,35 @@ void Parser::assembleBRANCH(int relative)
 
 	if (NextToken() != COMMA)
 		Fail("Expected ', <branch target>' after first argument to branch instruction, found %s.", Token.c_str());
-	auto param2 = ParseExpression();
+	unsigned fixup2, fixup3, fixup4;
+	auto param2 = ParseExpression(&fixup2);
 	switch (NextToken())
 	{default:
 		Fail("Expected ',' or end of line, found '%s'.", Token.c_str());
 	 case END:
-		doBRASource(param2);
+		doBRASource(param2, fixup2);
 		break;
 	 case COMMA:
-		auto param3 = ParseExpression();
+		auto param3 = ParseExpression(&fixup3);
 		switch (NextToken())
 		{default:
 			Fail("Expected ',' or end of line, found '%s'.", Token.c_str());
 		 case END: // we have 3 arguments => #2 and #3 are branch target
-			doBRASource(param2);
-			doBRASource(param3);
+			doBRASource(param2, fixup2);
+			doBRASource(param3, fixup3);
 			break;
 		 case COMMA: // we have 4 arguments, so #2 is a target and #3 the first source
 			doALUTarget(param2, true);
-			doBRASource(param3);
-			doBRASource(ParseExpression());
+			doBRASource(param3, fixup3);
+			auto param4 = ParseExpression(&fixup4);
+			doBRASource(param4, fixup4);
 			if (NextToken() != END)
 				Fail("Expected end of line after branch instruction.");
 		}
 	}
 
 	// add branch target flag for the branch point unless the target is 0
-	if (Instruct.Reg || Instruct.Immd.uValue != 0)
+	if (Instruct.Reg || Instruct.Immd.uValue != 0 || FixupLabel)
 	{	size_t pos = PC + 4;
 		FlagsSize(pos + 1);
 		InstFlags[pos] |= IF_BRANCH_TARGET;
@@ -943,12 +1286,99 @@ void Parser::assembleSIG(int bits)
 	}
 }
 
+const Parser::opEntry<8>* Parser::findOpcode(const char* name)
+{	static const perfect_hash<decltype(opcodeMap)> opcodeIndex(opcodeMap);
+	return opcodeIndex.find(name);
+}
+
+bool Parser::wouldConflict(const opEntry<8>& op)
+{	bool addUsed = Instruct.WAddrA != Inst::R_NOP || Instruct.OpA != Inst::A_NOP;
+	bool mulUsed = Instruct.WAddrM != Inst::R_NOP || Instruct.OpM != Inst::M_NOP;
+	if (op.Func == &Parser::assembleADD)
+	{	if (Instruct.Sig >= Inst::S_LDI)
+			return true;
+		// Only nop, v8adds and v8subs may use the MUL ALU instead.
+		return addUsed && (mulUsed || (op.Arg != Inst::A_NOP && op.Arg != Inst::A_V8ADDS && op.Arg != Inst::A_V8SUBS));
+	}
+	if (op.Func == &Parser::assembleMUL)
+	{	if (Instruct.Sig >= Inst::S_LDI)
+			return true;
+		// Only nop, v8adds and v8subs may use the ADD ALU instead.
+		return mulUsed && (addUsed || (op.Arg != Inst::M_NOP && op.Arg != Inst::M_V8ADDS && op.Arg != Inst::M_V8SUBS));
+	}
+	if (op.Func == &Parser::assembleMOV)
+	{	if (Instruct.Sig == Inst::S_BRANCH)
+			return true;
+		bool isLDI = Instruct.Sig == Inst::S_LDI;
+		bool useMUL = (Flags() & IF_HAVE_NOP) || Instruct.WAddrA != Inst::R_NOP || (!isLDI && Instruct.OpA != Inst::A_NOP);
+		return useMUL && (Instruct.WAddrM != Inst::R_NOP || (!isLDI && Instruct.OpM != Inst::M_NOP));
+	}
+	if (op.Func == &Parser::assembleSIG)
+		return Instruct.Sig != Inst::S_NONE;
+	if (op.Func == &Parser::assembleBRANCH)
+		return !Instruct.isVirgin();
+	return false;
+}
+
+bool Parser::tryCombine(size_t pos)
+{	const opEntry<8>* op = findOpcode(Token.c_str());
+	if (!op || wouldConflict(*op))
+		return false;
+
+	const token* tokenbak = TokenAt;
+	size_t msgbak = Messages.size();
+	// The existing instruction might already refer to a label that is not yet defined.
+	bool fixedup = false;
+	for (auto f = Fixups.rbegin(); f != Fixups.rend() && f->Inst >= pos - 1; ++f)
+		if (f->Inst == pos - 1)
+		{	FixupLabel = f->Label + 1;
+			fixedup = true;
+			break;
+		}
+	bool conflict = false;
+	Combining = true;
+	try
+	{	// Try to parse into existing instruction.
+		ParseInstruction();
+	} catch (const combineConflict&)
+	{	conflict = true;
+	} catch (const string&)
+	{	conflict = true;
+	}
+	Combining = false;
+	if (conflict)
+	{	FixupLabel = 0;
+		AbsLabel = false;
+		// Restore the opcode token.
+		TokenAt = tokenbak - 1;
+		NextToken();
+		Messages.resize(msgbak);
+		return false;
+	}
+
+	Instructions[pos-1] = Instruct.encode();
+	if (FixupLabel && !fixedup)
+		Fixups.push_back({(unsigned)pos - 1, FixupLabel - 1});
+	FixupLabel = 0;
+	if (AbsLabel)
+	{	InstFlags[pos-1] |= IF_ABSOLUTE;
+		AbsLabel = false;
+	}
+	if (Pass2)
+	{	// Messages of the attempt have been deferred.
+		for (size_t i = msgbak; i < Messages.size(); ++i)
+			emitMsg(Messages[i].Level, renderMsg(Messages[i]));
+		Messages.resize(msgbak);
+	}
+	return true;
+}
+
 void Parser::ParseInstruction()
 {
 	auto& flags = Flags();
 	while (true)
 	{	flags &= ~IF_CMB_ALLOWED;
-		const opEntry<8>* op = binary_search(opcodeMap, Token.c_str());
+		const opEntry<8>* op = findOpcode(Token.c_str());
 		if (!op)
 			Fail("Invalid opcode or unknown macro: %s", Token.c_str());
 
@@ -976,8 +1406,9 @@ void Parser::ParseInstruction()
 
 void Parser::defineLabel()
 {
+	impure();
 	// Lookup symbol
-	const auto& lname = LabelsByName.emplace(Token, LabelCount);
+	const auto& lname = LabelsByName.emplace(tokenId(), LabelCount);
 	label* lp;
 	if (lname.second)
 	{	// new label, not yet referenced
@@ -1004,6 +1435,8 @@ void Parser::defineLabel()
 	else if (lp->Name != Token || lp->Value != PC * sizeof(uint64_t))
 		Fail("Inconsistent Label definition during Pass 2.");
 	lp->Definition = *Context.back();
+	if (!isdigit(lp->Name[0]))
+		LastLabel = lp - &Labels.front() + 1;
 
 	if (Preprocessed)
 	{	fputs(Token.c_str(), Preprocessed);
@@ -1024,6 +1457,27 @@ void Parser::parseLabel()
 	}
 }
 
+void Parser::parseGLOBAL(int)
+{
+	if (doPreprocessor())
+		return;
+
+	while (true)
+	{	if (NextToken() != WORD)
+			Fail("Expected label name after .global, found '%s'.", Token.c_str());
+		if (find(Exports.begin(), Exports.end(), TokenId) == Exports.end())
+			Exports.push_back(TokenId);
+		switch (NextToken())
+		{default:
+			Fail("Expected ',' or end of line, found '%s'.", Token.c_str());
+		 case COMMA:
+			continue;
+		 case END:
+			return;
+		}
+	}
+}
+
 void Parser::parseDATA(int type)
 { int count = 0;
 	uint64_t target = 0;
@@ -1076,52 +1530,58 @@ void Parser::beginREP(int)
 	if (doPreprocessor())
 		return;
 
-	AtMacro = &Macros[".rep"];
+	AtMacro = &Macros[RepMacro];
 	AtMacro->Definition = *Context.back();
+	AtMacro->Args.clear();
+	AtMacro->Content.clear();
+	AtMacro->Count = 0; // no loop count after errors
 
 	if (NextToken() != WORD)
 		Fail("Expected loop variable name after .rep.");
 
-	AtMacro->Args.push_back(Token);
+	AtMacro->Args.push_back(TokenId);
 	if (NextToken() != COMMA)
 		Fail("Expected ', <count>' at .rep.");
 	const auto& expr = ParseExpression();
 	if (expr.Type != V_INT)
 		Fail("Second argument to .rep must be an integral number. Found %s", expr.toString().c_str());
+	if (expr.iValue < 0)
+		Fail("Second argument to .rep must not be negative. Found %i", expr.iValue);
 	if (NextToken() != END)
 		Fail("Expected end of line.");
-	AtMacro->Args.push_back(expr.toString());
+	AtMacro->Count = expr.uValue;
 }
 
 void Parser::endREP(int)
 {
-	auto iter = Macros.find(".rep");
+	auto iter = Macros.find(RepMacro);
 	if (AtMacro != &iter->second)
 	{	if (doPreprocessor())
 			return;
 		Fail(".endr without .rep");
 	}
 
-	const macro m = *AtMacro;
+	// The body is already tokenized with the loop variable bound to argument slot 1.
+	const macro m = move(*AtMacro);
 	AtMacro = NULL;
 	Macros.erase(iter);
 
-	if (m.Args.size() != 2)
-		return; // no loop count => 0
+	if (!m.Count)
+		return;
 
 	// Setup invocation context
-	saveContext ctx(*this, new fileContext(CTX_MACRO, m.Definition.File, m.Definition.Line));
+	saveContext ctx(*this, CTX_REP, m.Definition.File, m.Definition.Line);
 
 	// loop
-	uint32_t count;
-	sscanf(m.Args[1].c_str(), "%i", &count);
 	auto& current = *Context.back();
-	for (uint32_t& i = current.Consts.emplace(m.Args.front(), constDef(exprValue(0), current)).first->second.Value.uValue;
-		i < count; ++i)
-	{	// Invoke rep
-		for (const string& line : m.Content)
+	constDef& var = *defineConst(current, m.Args.front(), constDef(exprValue(0), current)).first;
+	current.Args.push_back(&var);
+	for (uint32_t& i = var.Value.uValue; i < m.Count; ++i)
+	{	// Invoke rep, each iteration starts over at the .rep line
+		Context.back()->Line = m.Definition.Line;
+		for (const sourceLine& line : m.Content.Lines)
 		{	++Context.back()->Line;
-			strncpy(Line, line.c_str(), sizeof(Line));
+			setLine(m.Content, line);
 			ParseLine();
 		}
 	}
@@ -1149,8 +1609,7 @@ void Parser::beginBACK(int)
 	if (pos)
 		Instruct.decode(Instructions[pos-1]);
 
-	if (Pass2)
-		while (++pos < PC + Back)
+	while (++pos < PC + Back)
 			if (InstFlags[pos] & IF_BRANCH_TARGET)
 				Msg(WARNING, ".back crosses branch target at address 0x%x. Code might not work.", pos*8);
 }
@@ -1189,11 +1648,17 @@ void Parser::parseCLONE(int)
 	param2.uValue += param1.uValue; // end offset rather than count
 	if (Pass2 && param2.uValue >= Instructions.size())
 		Fail("TODO: Cannot clone behind the end of the code.");
+	if (param2.uValue > PC + Back)
+		NeedPass2 = true; // instructions not yet assembled
 
 	for (size_t src = param1.uValue; src < param2.uValue; ++src)
-	{	InstFlags[PC] |= InstFlags[src] & ~IF_BRANCH_TARGET;
+	{	InstFlags[PC] |= InstFlags[src] & ~(IF_BRANCH_TARGET|IF_ABSOLUTE);
+		AbsLabel = (InstFlags[src] & IF_ABSOLUTE) != 0;
 		if ((Instructions[src] & 0xF000000000000000ULL) == 0xF000000000000000ULL)
 			Msg(WARNING, "You should not clone branch instructions. (#%u)", src - param1.uValue);
+		for (const auto& f : Fixups)
+			if (f.Inst == src)
+				FixupLabel = f.Label + 1;
 		StoreInstruction(Instructions[src]);
 	}
 	// Restore last instruction to provide combine support
@@ -1208,7 +1673,7 @@ void Parser::parseSET(int flags)
 
 	if (NextToken() != WORD)
 		Fail("Directive .set requires identifier.");
-	string name = Token;
+	ident name = TokenId;
 	switch (NextToken())
 	{default:
 		Fail("Directive .set requires ', <value>' or '(<arguments>) <value>'. Fount %s.", Token.c_str());
@@ -1217,7 +1682,7 @@ void Parser::parseSET(int flags)
 		 next:
 			if (NextToken() != WORD)
 				Fail("Function argument name expected. Found '%s'.", Token.c_str());
-			func.Args.push_back(Token);
+			func.Args.push_back(TokenId);
 			switch (NextToken())
 			{default:
 				Fail("Expected ',' or ')' after function argument.");
@@ -1232,9 +1697,18 @@ void Parser::parseSET(int flags)
 			}
 
 			// Anything after ')' is function body and evaluated delayed
-			At += strspn(At, " \t\r\n,");
-			func.DefLine = Line;
-			func.Start = At;
+			while (TokenAt->Type == COMMA)
+				++TokenAt;
+			func.DefLine.assign(Line, lineEnd() - Line);
+			{	const token* end = TokenAt;
+				while (end->Type != END)
+					++end;
+				func.Body.assign(TokenAt, end + 1);
+				for (token& tok : func.Body)
+					tok.Arg = 0;
+			}
+			compileFunction(func);
+			clearMemos();
 
 			const auto& ret = Functions.emplace(name, func);
 			if (!ret.second)
@@ -1246,23 +1720,41 @@ void Parser::parseSET(int flags)
 			break;
 		}
 	 case COMMA:
-		{	exprValue expr = ParseExpression();
+		{	unsigned fixup;
+			exprValue expr = ParseExpression(&fixup);
 			if (NextToken() != END)
 				Fail("Syntax error: unexpected %s.", Token.c_str());
 
 			auto& current = flags & C_LOCAL ? *Context.back() : *Context.front();
-			auto r = current.Consts.emplace(name, constDef(expr, current));
+			if (AtMemo && current.Level < AtMemo->Level)
+				impure();
+			auto r = defineConst(current, name, constDef(expr, current, fixup));
 			if (!r.second)
 			{	if (flags & C_CONST)
 					// redefinition not allowed
 					Fail("Identifier %s has already been defined at %s.",
-						name.c_str(), r.first->second.Definition.toString().c_str());
-				r.first->second.Value = expr;
+						Idents.Name(name).c_str(), r.first->Definition.toString().c_str());
+				r.first->Value = expr;
+				r.first->Fixup = fixup;
 			}
 		}
 	}
 }
 
+pair<Parser::constDef*,bool> Parser::defineConst(fileContext& ctx, ident name, const constDef& def)
+{	// find binding of ctx or the insert position in order of context level
+	auto& bindings = Symbols[name];
+	auto pos = bindings.end();
+	while (pos != bindings.begin() && pos[-1].Level > ctx.Level)
+		--pos;
+	if (pos != bindings.begin() && pos[-1].Level == ctx.Level)
+		return make_pair(pos[-1].Def, false);
+	ctx.Consts.push_back(constEntry{name, def});
+	constDef* d = &ctx.Consts.back().Def;
+	bindings.insert(pos, binding{ctx.Level, d});
+	return make_pair(d, true);
+}
+
 void Parser::parseUNSET(int flags)
 {
 	if (doPreprocessor())
@@ -1270,15 +1762,31 @@ void Parser::parseUNSET(int flags)
 
 	if (NextToken() != WORD)
 		Fail("Directive .unset requires identifier.");
-	string Name = Token;
+	ident name = TokenId;
 	if (NextToken() != END)
 		Fail("Syntax error: unexpected %s.", Token.c_str());
 
-	auto& consts = (flags & C_LOCAL ? Context.back() : Context.front())->Consts;
-	auto r = consts.find(Name);
-	if (r == consts.end())
-		return Msg(WARNING, "Cannot unset %s because it has not yet been definied in the required context.", Name.c_str());
-	consts.erase(r);
+	auto& ctx = *(flags & C_LOCAL ? Context.back() : Context.front());
+	if (AtMemo && ctx.Level < AtMemo->Level)
+		impure();
+	auto s = Symbols.find(name);
+	if (s != Symbols.end())
+		for (auto b = s->second.end(); b-- != s->second.begin(); )
+			if (b->Level == ctx.Level)
+			{	const constDef* def = b->Def;
+				for (auto& arg : ctx.Args)
+					if (arg == def)
+						arg = NULL;
+				s->second.erase(b);
+				// Keep the entry in place, only the binding is removed.
+				for (auto& c : ctx.Consts)
+					if (&c.Def == def)
+					{	c.Name = 0;
+						break;
+					}
+				return;
+			}
+	Msg(WARNING, "Cannot unset %s because it has not yet been definied in the required context.", Idents.Name(name).c_str());
 }
 
 bool Parser::doCondition()
@@ -1359,8 +1867,10 @@ void Parser::beginMACRO(int flags)
 		  AtMacro->Definition.toString().c_str());
 	if (NextToken() != WORD)
 		Fail("Expected macro name.");
-	AtMacro = &(flags & M_FUNC ? MacroFuncs : Macros)[Token];
-	if (AtMacro->Definition.File.size())
+	AtMacro = &(flags & M_FUNC ? MacroFuncs : Macros)[TokenId];
+	if (flags & M_FUNC)
+		clearMemos();
+	if (AtMacro->Definition.File)
 	{	Msg(INFO, "Redefinition of macro %s.\n"
 		          "  Previous definition at %s.",
 		  Token.c_str(), AtMacro->Definition.toString().c_str());
@@ -1390,7 +1900,7 @@ void Parser::beginMACRO(int flags)
 			// Macro argument
 			if (NextToken() != WORD)
 				Fail("Macro argument name expected. Found '%s'.", Token.c_str());
-			AtMacro->Args.push_back(Token);
+			AtMacro->Args.push_back(TokenId);
 			break;
 		 case BRACE2:
 			if (brace != 1)
@@ -1423,40 +1933,45 @@ void Parser::doMACRO(macros_t::const_iterator m)
 	// Fetch macro arguments
 	const auto& argnames = m->second.Args;
 	vector<exprValue> args;
+	vector<unsigned> fixups;
 	if (argnames.size())
 	{	args.reserve(argnames.size());
+		fixups.reserve(argnames.size());
 		while (true)
-		{	args.emplace_back(ParseExpression());
+		{	fixups.emplace_back();
+			args.emplace_back(ParseExpression(&fixups.back()));
 			switch (NextToken())
 			{default:
 				Fail("internal error");
 			 case COMMA:
 				if (args.size() == argnames.size())
-					Fail("Too much arguments for macro %s.", m->first.c_str());
+					Fail("Too much arguments for macro %s.", Idents.Name(m->first).c_str());
 				continue;
 			 case END:
 				if (args.size() != argnames.size())
-					Fail("Too few arguments for macro %s.", m->first.c_str());
+					Fail("Too few arguments for macro %s.", Idents.Name(m->first).c_str());
 			}
 			break;
 		}
 	} else if (NextToken() != END)
-		Fail("The macro %s does not take arguments.", m->first.c_str());
+		Fail("The macro %s does not take arguments.", Idents.Name(m->first).c_str());
 
 	// Setup invocation context
-	saveContext ctx(*this, new fileContext(CTX_MACRO, m->second.Definition.File, m->second.Definition.Line));
+	saveContext ctx(*this, CTX_MACRO, m->second.Definition.File, m->second.Definition.Line);
 
 	// setup args inside new context to avoid interaction with argument values that are also functions.
 	auto& current = *Context.back();
-	current.Consts.reserve(current.Consts.size() + argnames.size());
+	current.Args.reserve(argnames.size());
 	size_t n = 0;
 	for (auto arg : argnames)
-		current.Consts.emplace(arg, constDef(args[n++], current));
+	{	current.Args.push_back(defineConst(current, arg, constDef(args[n], current, fixups[n])).first);
+		++n;
+	}
 
 	// Invoke macro
-	for (const string& line : m->second.Content)
+	for (const sourceLine& line : m->second.Content.Lines)
 	{	++Context.back()->Line;
-		strncpy(Line, line.c_str(), sizeof(Line));
+		setLine(m->second.Content, line);
 		ParseLine();
 	}
 }
@@ -1468,12 +1983,13 @@ exprValue Parser::doFUNCMACRO(macros_t::const_iterator m)
 
 	// Fetch macro arguments
 	const auto& argnames = m->second.Args;
-	vector<exprValue> args;
+	memoKey key = { &m->second, {} };
+	auto& args = key.Args;
 	args.reserve(argnames.size());
 	if (argnames.size() == 0)
 	{	// no arguments
 		if (NextToken() != BRACE2)
-			Fail("Expected ')' because function %s has no arguments.", m->first.c_str());
+			Fail("Expected ')' because function %s has no arguments.", Idents.Name(m->first).c_str());
 	} else
 	{next:
 		args.push_back(ParseExpression());
@@ -1481,34 +1997,37 @@ exprValue Parser::doFUNCMACRO(macros_t::const_iterator m)
 		{case BRACE2:
 			// End of argument list. Are we complete?
 			if (args.size() != argnames.size())
-				Fail("Too few arguments for function %s. Expected %u, found %u.", m->first.c_str(), argnames.size(), args.size());
+				Fail("Too few arguments for function %s. Expected %u, found %u.", Idents.Name(m->first).c_str(), argnames.size(), args.size());
 			break;
 		 default:
-			Fail("Unexpected '%s' in argument list of function %s.", Token.c_str(), m->first.c_str());
+			Fail("Unexpected '%s' in argument list of function %s.", Token.c_str(), Idents.Name(m->first).c_str());
 		 case COMMA:
 			// next argument
 			if (args.size() == argnames.size())
-				Fail("Too much arguments for function %s. Expected %u.", m->first.c_str(), argnames.size());
+				Fail("Too much arguments for function %s. Expected %u.", Idents.Name(m->first).c_str(), argnames.size());
 			goto next;
 		}
 	}
 
+	exprValue ret;
+	if (lookupMemo(key, ret))
+		return ret;
+	memoScope memo(*this);
+
 	// Setup invocation context
-	saveLineContext ctx(*this, new fileContext(CTX_MACRO, m->second.Definition.File, m->second.Definition.Line));
+	saveLineContext ctx(*this, CTX_MACRO, m->second.Definition.File, m->second.Definition.Line);
 
 	// setup args inside new context to avoid interaction with argument values that are also functions.
 	auto& current = *Context.back();
-	current.Consts.reserve(current.Consts.size() + argnames.size());
+	current.Args.reserve(argnames.size());
 	size_t n = 0;
 	for (auto arg : argnames)
-		current.Consts.emplace(arg, constDef(args[n++], current));
+		current.Args.push_back(defineConst(current, arg, constDef(args[n++], current)).first);
 
 	// Invoke macro
-	exprValue ret;
-	for (const string& line : m->second.Content)
+	for (const sourceLine& line : m->second.Content.Lines)
 	{	++Context.back()->Line;
-		strncpy(Line, line.c_str(), sizeof(Line));
-		At = Line;
+		setLine(m->second.Content, line);
 		switch (NextToken())
 		{case DOT:
 			// directives
@@ -1518,7 +2037,7 @@ exprValue Parser::doFUNCMACRO(macros_t::const_iterator m)
 
 		 case COLON:
 		 label:
-			Msg(ERROR, "Label definition not allowed in functional macro %s.", m->first.c_str());
+			Msg(ERROR, "Label definition not allowed in functional macro %s.", Idents.Name(m->first).c_str());
 			break;
 
 		 default:
@@ -1526,18 +2045,19 @@ exprValue Parser::doFUNCMACRO(macros_t::const_iterator m)
 				break;
 			// read-ahead to see if the next token is a colon in which case
 			// this is a label.
-			if (*At == ':')
+			if (TokenAt->Type == COLON && Line + TokenAt->Pos == At)
 				goto label;
 			if (ret.Type != V_NONE)
 			{	Msg(ERROR, "Only one expression allowed per functional macro.");
 				break;
 			}
-			At -= Token.size();
+			pushBack();
 			ret = ParseExpression();
 		}
 	}
 	if (ret.Type == V_NONE)
-		Fail("Failed to return a value in functional macro %s.", m->first.c_str());
+		Fail("Failed to return a value in functional macro %s.", Idents.Name(m->first).c_str());
+	memo.Store(move(key), ret);
 	return ret;
 }
 
@@ -1548,12 +2068,13 @@ exprValue Parser::doFUNC(funcs_t::const_iterator f)
 
 	// Fetch macro arguments
 	const auto& argnames = f->second.Args;
-	vector<exprValue> args;
+	memoKey key = { &f->second, {} };
+	auto& args = key.Args;
 	args.reserve(argnames.size());
 	if (argnames.size() == 0)
 	{	// no arguments
 		if (NextToken() != BRACE2)
-			Fail("Expected ')' because function %s has no arguments.", f->first.c_str());
+			Fail("Expected ')' because function %s has no arguments.", Idents.Name(f->first).c_str());
 	} else
 	{next:
 		args.push_back(ParseExpression());
@@ -1561,33 +2082,300 @@ exprValue Parser::doFUNC(funcs_t::const_iterator f)
 		{case BRACE2:
 			// End of argument list. Are we complete?
 			if (args.size() != argnames.size())
-				Fail("Too few arguments for function %s. Expected %u, found %u.", f->first.c_str(), argnames.size(), args.size());
+				Fail("Too few arguments for function %s. Expected %u, found %u.", Idents.Name(f->first).c_str(), argnames.size(), args.size());
 			break;
 		 default:
-			Fail("Unexpected '%s' in argument list of function %s.", Token.c_str(), f->first.c_str());
+			Fail("Unexpected '%s' in argument list of function %s.", Token.c_str(), Idents.Name(f->first).c_str());
 		 case COMMA:
 			// next argument
 			if (args.size() == argnames.size())
-				Fail("Too much arguments for function %s. Expected %u.", f->first.c_str(), argnames.size());
+				Fail("Too much arguments for function %s. Expected %u.", Idents.Name(f->first).c_str(), argnames.size());
 			goto next;
 		}
 	}
 
+	exprValue ret;
+	if (lookupMemo(key, ret))
+		return ret;
+	memoScope memo(*this);
+
+	// Fast path: compiled function body
+	if (callFunction(f->second, args.data(), NULL, ret))
+	{	memo.Store(move(key), ret);
+		return ret;
+	}
+
 	// Setup invocation context
-	saveLineContext ctx(*this, new fileContext(CTX_FUNCTION, f->second.Definition.File, f->second.Definition.Line));
-	strncpy(Line, f->second.DefLine.c_str(), sizeof Line);
-	At = f->second.Start;
+	saveLineContext ctx(*this, CTX_FUNCTION, f->second.Definition.File, f->second.Definition.Line);
+	Line = f->second.DefLine.c_str();
+	LineTokens = TokenAt = &f->second.Body.front();
+	At = Line + TokenAt->Pos;
 	// setup args inside new context to avoid interaction with argument values that are also functions.
 	auto& current = *Context.back();
-	current.Consts.reserve(current.Consts.size() + argnames.size());
 	unsigned n = 0;
 	for (auto arg : argnames)
-		current.Consts.emplace(arg, constDef(args[n++], current));
+		defineConst(current, arg, constDef(args[n++], current));
 
-	const exprValue&& val = ParseExpression();
+	ret = ParseExpression();
 	if (NextToken() != END)
-		Fail("Function %s evaluated to an incomplete expression.", f->first.c_str());
-	return val;
+		Fail("Function %s evaluated to an incomplete expression.", Idents.Name(f->first).c_str());
+	memo.Store(move(key), ret);
+	return ret;
+}
+
+/// Exact comparison of values, exprValue::operator== treats registers with different access types as equal.
+static bool sameValue(const exprValue& l, const exprValue& r)
+{	if (l.Type != r.Type)
+		return false;
+	if (l.Type != V_REG)
+		return l.uValue == r.uValue;
+	return l.rValue.Num == r.rValue.Num && l.rValue.Type == r.rValue.Type && l.rValue.Rotate == r.rValue.Rotate;
+}
+
+bool Parser::memoKey::operator==(const memoKey& r) const
+{	if (Func != r.Func || Args.size() != r.Args.size())
+		return false;
+	for (size_t i = 0; i < Args.size(); ++i)
+		if (!sameValue(Args[i], r.Args[i]))
+			return false;
+	return true;
+}
+
+size_t Parser::memoHash::operator()(const memoKey& key) const
+{	uint64_t h = hash64(&key.Func, sizeof key.Func);
+	for (const exprValue& arg : key.Args)
+	{	// Do not hash the unused byte of register values.
+		uint32_t v[2] = { (uint32_t)arg.Type, arg.Type == V_REG ? arg.rValue.Num | arg.rValue.Type << 8 | arg.rValue.Rotate << 16 : arg.uValue };
+		h = hash64(v, sizeof v, h);
+	}
+	return (size_t)h;
+}
+
+Parser::memoScope::memoScope(Parser& parent)
+:	Parent(parent)
+,	Outer(parent.AtMemo)
+{	Frame.Level = parent.Context.size();
+	Frame.IfDepth = parent.AtIf.size();
+	parent.AtMemo = &Frame;
+}
+
+void Parser::memoScope::Store(memoKey&& key, const exprValue& result)
+{	if (Parent.AtIf.size() != Frame.IfDepth)
+		Frame.Pure = false;
+	if (Outer)
+	{	// The enclosing invocation depends on the same constants unless they are local to it.
+		Parent.AtMemo = Outer;
+		for (const memoRead& read : Frame.Reads)
+			if (read.Level < Outer->Level)
+				Parent.trackRead(read.Name, read.Level, read.Value);
+		Outer->Pure &= Frame.Pure;
+	}
+	if (Frame.Pure)
+		Parent.Memos[move(key)] = memoEntry{ move(Frame.Reads), result };
+}
+
+void Parser::trackRead(ident name, const binding* b)
+{	if (!AtMemo)
+		return;
+	if (!b)
+		trackRead(name, 0, exprValue());
+	else if (b->Level < AtMemo->Level)
+	{	if (b->Def->Fixup)
+			AtMemo->Pure = false; // depends on a label
+		trackRead(name, b->Level, b->Def->Value);
+	}
+}
+
+void Parser::trackRead(ident name, unsigned level, const exprValue& value)
+{	for (const memoRead& read : AtMemo->Reads)
+		if (read.Name == name)
+			return;
+	AtMemo->Reads.push_back(memoRead{name, level, value});
+}
+
+bool Parser::lookupMemo(const memoKey& key, exprValue& result)
+{	auto m = Memos.find(key);
+	if (m == Memos.end())
+		return false;
+	for (const memoRead& read : m->second.Reads)
+	{	auto s = Symbols.find(read.Name);
+		const binding* b = s != Symbols.end() && s->second.size() ? &s->second.back() : NULL;
+		if (b ? b->Def->Fixup || !sameValue(b->Def->Value, read.Value) : read.Value.Type != V_NONE)
+			return false;
+		trackRead(read.Name, b);
+	}
+	result = m->second.Result;
+	return true;
+}
+
+bool Parser::compileExpr(const function& f, const token*& tok, vector<funcOp>& code)
+{	unsigned depth = 0; // number of open braces
+	string text;
+	for (;; ++tok)
+	{	text.assign(f.DefLine, tok->Pos, tok->Len);
+		switch (tok->Type)
+		{default: // label references, element constants, ...
+			return false;
+		 case END:
+		 case COMMA:
+			return true;
+		 case BRACE2:
+			if (!depth)
+				return true;
+			--depth;
+			goto oper;
+		 case BRACE1:
+			++depth;
+		 case OP:
+		 oper:
+			{	const opInfo* op = binary_search(operatorMap, text.c_str());
+				if (!op)
+					return false;
+				code.emplace_back(funcOp::OPERATOR);
+				code.back().Op = op->Op;
+				break;
+			}
+		 case NUM:
+			code.emplace_back(funcOp::VALUE);
+			if (!parseNumber(text, code.back().Value))
+				return false;
+			break;
+		 case WORD:
+			{	auto arg = find(f.Args.begin(), f.Args.end(), tok->Id);
+				if (arg != f.Args.end())
+				{	if (count(arg, f.Args.end(), tok->Id) != 1)
+						return false;
+					code.emplace_back(funcOp::ARG);
+					code.back().Index = arg - f.Args.begin();
+					break;
+				}
+			}
+			if (tok[1].Type == BRACE1)
+			{	// Function call, resolved at invocation because the name might refer to a constant as well.
+				size_t call = code.size();
+				code.emplace_back(funcOp::CALL);
+				code.back().Name = tok->Id;
+				++tok;
+				do
+				{	++tok;
+					if (!compileExpr(f, tok, code))
+						return false;
+					code.emplace_back(funcOp::RETURN);
+					++code[call].Index;
+				} while (tok->Type == COMMA);
+				if (tok->Type != BRACE2)
+					return false;
+				break;
+			}
+			code.emplace_back(funcOp::SYMBOL);
+			code.back().Name = tok->Id;
+			{	const regEntry* rp = findRegister(text.c_str());
+				if (rp)
+					code.back().Value = rp->Value;
+			}
+			break;
+		}
+	}
+}
+
+void Parser::compileFunction(function& f)
+{	const token* tok = &f.Body.front();
+	if (compileExpr(f, tok, f.Code) && tok->Type == END)
+		f.Code.emplace_back(funcOp::RETURN);
+	else
+		f.Code.clear();
+}
+
+const exprValue* Parser::funcFrame::find(ident name) const
+{	for (const funcFrame* fp = this; fp; fp = fp->Parent)
+	{	const auto& args = fp->Func.Args;
+		auto arg = std::find(args.begin(), args.end(), name);
+		if (arg != args.end())
+			return fp->Args + (arg - args.begin());
+	}
+	return NULL;
+}
+
+bool Parser::execFunction(const funcOp*& op, const funcFrame& frame, Eval& eval)
+{	for (;; ++op)
+		switch (op->Type)
+		{case funcOp::VALUE:
+			eval.PushValue(op->Value);
+			break;
+		 case funcOp::ARG:
+			eval.PushValue(frame.Args[op->Index]);
+			break;
+		 case funcOp::SYMBOL:
+			// Arguments of calling functions take precedence like their constants in doFUNC.
+			if (frame.Parent)
+			{	const exprValue* arg = frame.Parent->find(op->Name);
+				if (arg)
+				{	eval.PushValue(*arg);
+					break;
+				}
+			}
+			{	auto s = Symbols.find(op->Name);
+				if (s != Symbols.end() && s->second.size())
+				{	const constDef* cdef = s->second.back().Def;
+					if (cdef->Fixup)
+						return false; // forward reference
+					trackRead(op->Name, &s->second.back());
+					eval.PushValue(cdef->Value);
+					break;
+				}
+			}
+			trackRead(op->Name, NULL);
+			if (op->Value.Type == V_NONE || Functions.count(op->Name) || MacroFuncs.count(op->Name))
+				return false;
+			eval.PushValue(op->Value);
+			break;
+		 case funcOp::OPERATOR:
+			if (!eval.PushOperator(op->Op))
+				return false;
+			break;
+		 case funcOp::CALL:
+			{	if (frame.Parent && frame.Parent->find(op->Name))
+					return false;
+				auto s = Symbols.find(op->Name);
+				if (s != Symbols.end() && s->second.size())
+					return false;
+				trackRead(op->Name, NULL);
+				auto f = Functions.find(op->Name);
+				if (f == Functions.end() || f->second.Args.size() != op->Index)
+					return false;
+				vector<exprValue> args(op->Index);
+				for (exprValue& arg : args)
+				{	Eval argeval;
+					if (!execFunction(++op, frame, argeval))
+						return false;
+					arg = argeval.Evaluate();
+				}
+				exprValue value;
+				if (!callFunction(f->second, args.data(), &frame, value))
+					return false;
+				eval.PushValue(value);
+				break;
+			}
+		 case funcOp::RETURN:
+			return true;
+		}
+}
+
+bool Parser::callFunction(const function& f, const exprValue* args, const funcFrame* parent, exprValue& result)
+{	if (f.Code.empty())
+		return false;
+	funcFrame frame = { f, args, parent };
+	const funcOp* op = &f.Code.front();
+	Eval eval;
+	try
+	{	if (!execFunction(op, frame, eval))
+			return false;
+		result = eval.Evaluate();
+		return true;
+	} catch (const Eval::Fail&)
+	{	// Let the parser create the diagnostic.
+		return false;
+	}
 }
 
 void Parser::doINCLUDE(int)
@@ -1595,20 +2383,18 @@ void Parser::doINCLUDE(int)
 	if (doPreprocessor())
 		return;
 
-	At += strspn(At, " \t\r\n");
-	{	// remove trailing blanks
-		char* cp = At + strlen(At);
-		while (strchr(" \t\r\n", *--cp))
-			*cp = 0;
-	}
-	size_t len = strlen(At);
-	if (*At != '"' || At[len-1] != '"')
-		Fail("Syntax error. Expected \"<file-name>\" after .include, found '%s'.", At);
+	At += strspn(At, " \t\r");
+	size_t len = lineEnd() - At;
+	// remove trailing blanks
+	while (len && strchr(" \t\r\n", At[len-1]))
+		--len;
+	if (len < 2 || *At != '"' || At[len-1] != '"')
+		Fail("Syntax error. Expected \"<file-name>\" after .include, found '%.*s'.", (int)len, At);
 	Token.assign(At+1, len-2);
 
-	Token = relpath(Context.back()->File, Token);
+	Token = resolveInclude(Token);
 
-	saveContext ctx(*this, new fileContext(CTX_INCLUDE, Token, 0));
+	saveContext ctx(*this, CTX_INCLUDE, FileNames.Intern(Token), 0);
 
 	ParseFile();
 }
@@ -1618,9 +2404,16 @@ void Parser::ParseDirective()
 	if (NextToken() != WORD)
 		Fail("Expected assembler directive after '.'. Found '%s'.", Token.c_str());
 
-	const opEntry<8>* op = binary_search(directiveMap, Token.c_str());
+	static const perfect_hash<decltype(directiveMap)> directiveIndex(directiveMap);
+	const opEntry<8>* op = directiveIndex.find(Token.c_str());
 	if (!op)
 		Fail("Invalid assembler directive: %s", Token.c_str());
+	// Directives that cannot have side effects outside a functional macro. .set and .unset check themselves.
+	if ( op->Func != &Parser::parseSET && op->Func != &Parser::parseUNSET
+		&& op->Func != &Parser::parseIF && op->Func != &Parser::parseELSEIF
+		&& op->Func != &Parser::parseELSE && op->Func != &Parser::parseENDIF
+		&& op->Func != &Parser::parseASSERT )
+		impure();
 
 	(this->*op->Func)(op->Arg);
 }
@@ -1628,7 +2421,7 @@ void Parser::ParseDirective()
 bool Parser::doPreprocessor(preprocType type)
 {
 	if (AtMacro && (type & PP_MACRO))
-	{	AtMacro->Content.push_back(Line);
+	{	AtMacro->Content.append(Line, LineTokens, AtMacro->Args);
 		return true;
 	}
 	return (type & PP_IF) && isDisabled();
@@ -1648,11 +2441,11 @@ void Parser::ParseLine()
 		if (isinst)
 			goto def;
 		// directives
+		InstColumn = column();
 		ParseDirective();
 		return;
 
 	 case END:
-		*Line = 0;
 		doPreprocessor(PP_MACRO);
 		return;
 
@@ -1683,38 +2476,27 @@ void Parser::ParseLine()
 
 		// read-ahead to see if the next token is a colon in which case
 		// this is a label.
-		if (*At == ':')
+		if (TokenAt->Type == COLON && Line + TokenAt->Pos == At)
 		{	defineLabel();
 			InstFlags[pos] |= IF_BRANCH_TARGET;
-			++At;
+			NextToken(); // skip ':'
 			goto next;
 		}
 
 		// Try macro
-		macros_t::const_iterator m = Macros.find(Token);
+		macros_t::const_iterator m = Macros.find(TokenId);
 		if (m != Macros.end())
 		{	doMACRO(m);
 			return;
 		}
 
-		if (trycombine)
-		{	char* atbak = At;
-			bool succbak = Success;
-			string tokenbak = Token;
-			try
-			{	// Try to parse into existing instruction.
-				ParseInstruction();
-				Instructions[pos-1] = Instruct.encode();
-				return;
-			} catch (const string& msg)
-			{	// Combine failed => try new instruction.
-				At = atbak;
-				Success = succbak;
-				Token = tokenbak;
-			}
-		}
+		if (trycombine && tryCombine(pos))
+			return;
 		// new instruction
 		Instruct.reset();
+		FixupLabel = 0;
+		AbsLabel = false;
+		InstColumn = column();
 
 		ParseInstruction();
 		StoreInstruction(Instruct.encode());
@@ -1722,44 +2504,123 @@ void Parser::ParseLine()
 	}
 }
 
-void Parser::ParseFile()
-{
-	FILE* f = fopen(Context.back()->File.c_str(), "r");
-	if (!f)
-		Fail("Failed to open file %s.", Context.back()->File.c_str());
-	try
-	{	while (fgets(Line, sizeof(Line), f))
-		{	++Context.back()->Line;
-			try
-			{	ParseLine();
-			} catch (const string& msg)
-			{	// recover from errors
-				fputs(msgpfx[ERROR], stderr);
-				fputs(msg.c_str(), stderr);
-				fputc('\n', stderr);
+Parser::sourceCache Parser::SourceCache;
+
+Parser::sourcePtr Parser::getSource(const string& file)
+{	char* canonical = realpath(file.c_str(), NULL);
+	if (!canonical)
+		return sourcePtr();
+	string key(canonical);
+	free(canonical);
+	fileStamp stamp;
+	if (!stamp.load(key.c_str()))
+		return sourcePtr();
+
+	{	lock_guard<mutex> lock(SourceCache.Lock);
+		auto it = SourceCache.Files.find(key);
+		if (it != SourceCache.Files.end() && it->second->Stamp == stamp)
+			return it->second;
+	}
+
+	// Load outside the lock to let other parsers continue.
+	shared_ptr<sourceFile> src = make_shared<sourceFile>();
+	src->Stamp = stamp;
+	if (!src->Content.load(key.c_str()))
+		return sourcePtr();
+	// Tokenize the lines in place
+	src->Data = src->Content.data();
+	tokenizeAll(*src, src->Data, src->Content.size());
+
+	lock_guard<mutex> lock(SourceCache.Lock);
+	sourcePtr& entry = SourceCache.Files[key];
+	// Another parser might have loaded the same file meanwhile.
+	if (entry && entry->Stamp == stamp)
+		return entry;
+	return entry = src;
+}
+
+void Parser::tokenizeAll(lineBuffer& buffer, const char* data, size_t size)
+{	const char* end = data + size;
+	for (const char* cp = data; cp != end; cp = (const char*)memchr(cp, '\n', end - cp) + 1)
+	{	buffer.Lines.push_back({(unsigned)(cp - data), (unsigned)buffer.Tokens.size()});
+		Tokenize(cp, buffer.Tokens);
+	}
+}
+
+Parser::sourcePtr Parser::findSource(const string& file)
+{	auto ret = Sources.emplace(file, sourcePtr());
+	sourcePtr& src = ret.first->second;
+	if (ret.second)
+	{	if (Reader)
+		{	shared_ptr<sourceFile> content = make_shared<sourceFile>();
+			if (Reader(file, content->Text))
+			{	if (content->Text.size() && content->Text.back() != '\n')
+					content->Text.push_back('\n');
+				tokenizeAll(*content, content->Text.c_str(), content->Text.size());
+				src = content;
 			}
+		} else
+			src = getSource(file);
+	}
+	return src;
+}
+
+const Parser::lineBuffer& Parser::loadFile(const string& file)
+{	const sourcePtr& src = findSource(file);
+	if (!src)
+		Fail("Failed to open file %s.", file.c_str());
+	return *src;
+}
+
+const string& Parser::resolveInclude(const string& name)
+{	const string& current = FileNames.Name(Context.back()->File);
+	string key;
+	key.reserve(current.size() + name.size() + 1);
+	key.append(current).append(1, '\n').append(name);
+	auto ret = IncludeNames.emplace(key, string());
+	string& path = ret.first->second;
+	if (ret.second)
+	{	path = relpath(current, name);
+		if (name.size() && name.front() != '/' && !findSource(path))
+			for (const string& dir : IncludePaths)
+			{	string candidate = relpath(dir + '/', name);
+				if (findSource(candidate))
+				{	path = candidate;
+					break;
+				}
+			}
+	}
+	return path;
+}
 
-			if (AtMacro && AtMacro->Definition.Line == 0)
-				Fail("!!!");
+void Parser::ParseFile()
+{	const lineBuffer& src = loadFile(FileNames.Name(Context.back()->File));
+	for (const sourceLine& line : src.Lines)
+	{	++Context.back()->Line;
+		setLine(src, line);
+		try
+		{	ParseLine();
+		} catch (const string& msg)
+		{	// recover from errors
+			emitMsg(ERROR, msg);
 		}
-		fclose(f);
-	} catch (...)
-	{	fclose(f);
-		throw;
+
+		if (AtMacro && AtMacro->Definition.Line == 0)
+			Fail("!!!");
 	}
 }
+
 void Parser::ParseFile(const string& file)
 {	if (Pass2)
 		throw string("Cannot add another file after pass 2 has been entered.");
-	saveContext ctx(*this, new fileContext(CTX_INCLUDE, file, 0));
+	ident id = FileNames.Intern(file);
+	saveContext ctx(*this, CTX_INCLUDE, id, 0);
 	try
 	{	ParseFile();
-		Filenames.emplace_back(file);
+		Filenames.push_back(id);
 	} catch (const string& msg)
 	{	// recover from errors
-		fputs(msgpfx[ERROR], stderr);
-		fputs(msg.c_str(), stderr);
-		fputc('\n', stderr);
+		emitMsg(ERROR, msg);
 	}
 }
 
@@ -1767,14 +2628,20 @@ void Parser::ResetPass()
 {	AtMacro = NULL;
 	AtIf.clear();
 	Context.clear();
-	Context.emplace_back(new fileContext(CTX_ROOT, string(), 0));
+	Symbols.clear();
+	Memos.clear();
+	AtMemo = NULL;
+	Context.emplace_back(new fileContext(CTX_ROOT, 0, 0));
 	Functions.clear();
 	Macros.clear();
 	LabelsByName.clear();
 	LabelCount = 0;
-	InstFlags.clear();
 	PC = 0;
 	Instruct.reset();
+	FixupLabel = 0;
+	AbsLabel = false;
+	InstColumn = 0;
+	LastLabel = 0;
 }
 
 void Parser::EnsurePass2()
@@ -1789,18 +2656,41 @@ void Parser::EnsurePass2()
 	// Check all labels
 	for (auto& label : Labels)
 	{	if (!label.Definition)
-			Msg(ERROR, "Label '%s' is undefined. Referenced from %s.\n",
-				label.Name.c_str(), label.Reference.toString().c_str());
+		{	// Named labels of a relocatable object are resolved by the linker.
+			if (Relocatable && !isdigit(label.Name[0]))
+				label.Import = true;
+			else
+				Msg(ERROR, "Label '%s' is undefined. Referenced from %s.\n",
+					label.Name.c_str(), label.Reference.toString().c_str());
+		}
 		if (!label.Reference)
 			Msg(INFO, "Label '%s' defined at %s is not used.\n",
 				label.Name.c_str(), label.Definition.toString().c_str());
-		// prepare for next pass
-		label.Definition.Line = 0;
 	}
 
-	for (auto file : Filenames)
-	{	saveContext ctx(*this, new fileContext(CTX_INCLUDE, file, 0));
-		ParseFile();
+	if (NeedPass2)
+	{	// Forward references could not be fixed up => reassemble with all labels known.
+		clearMessages();
+		Fixups.clear();
+		InstFlags.clear();
+		DebugChains.clear();
+		DebugLast.clear();
+		DebugLines.clear();
+		for (auto& label : Labels)
+			label.Definition.Line = 0;
+		for (auto file : Filenames)
+		{	saveContext ctx(*this, CTX_INCLUDE, file, 0);
+			ParseFile();
+		}
+	} else
+	{	// Single pass: resolve forward references.
+		for (const auto& msg : Messages)
+			emitMsg(msg.Level, renderMsg(msg));
+		clearMessages();
+		for (const auto& f : Fixups)
+			Object::Patch(Instructions[f.Inst], Labels[f.Label].Value);
+		// Keep the references to imports, see GetObject.
+		Fixups.erase(remove_if(Fixups.begin(), Fixups.end(), [this](const fixup& f) { return !Labels[f.Label].Import; }), Fixups.end());
 	}
 
 	// Optimize instructions
@@ -1818,9 +2708,23 @@ Parser::Parser()
 
 void Parser::Reset()
 { ResetPass();
+	Success = true;
+	Back = 0;
+	MacroFuncs.clear();
+	Instructions.clear();
 	Labels.clear();
+	Fixups.clear();
+	Exports.clear();
+	InstFlags.clear();
+	DebugChains.clear();
+	DebugLast.clear();
+	DebugLines.clear();
+	clearMessages();
 	Pass2 = false;
+	NeedPass2 = false;
 	Filenames.clear();
+	Sources.clear();
+	IncludeNames.clear();
 }
 
 const vector<uint64_t>& Parser::GetInstructions()
@@ -1829,3 +2733,146 @@ const vector<uint64_t>& Parser::GetInstructions()
 
 	return Instructions;
 }
+
+void Parser::GetLabels(vector<pair<string,unsigned>>& dst)
+{
+	EnsurePass2();
+
+	dst.clear();
+	for (const auto& label : Labels)
+		if (label.Definition)
+			dst.emplace_back(label.Name, label.Value);
+}
+
+void Parser::GetExports(vector<pair<string,unsigned>>& dst)
+{
+	EnsurePass2();
+
+	dst.clear();
+	for (ident name : Exports)
+	{	// LabelsByName does not survive a single pass.
+		const string& n = Idents.Name(name);
+		auto l = find_if(Labels.begin(), Labels.end(), [&n](const label& l) { return l.Definition && l.Name == n; });
+		if (l == Labels.end())
+			throw stringf("The label %s exported by .global is not defined.", n.c_str());
+		dst.emplace_back(n, l->Value);
+	}
+}
+
+void Parser::GetRelocations(vector<uint32_t>& dst)
+{
+	EnsurePass2();
+
+	dst.clear();
+	for (unsigned i = 0; i < Instructions.size(); ++i)
+		if (InstFlags[i] & IF_ABSOLUTE)
+			dst.push_back(i);
+}
+
+void Parser::GetObject(Object& dst)
+{
+	EnsurePass2();
+
+	dst.Code = Instructions;
+	dst.Symbols.clear();
+	dst.Relocs.clear();
+	vector<pair<string,unsigned>> exports;
+	GetExports(exports);
+	for (const auto& e : exports)
+		dst.Symbols.push_back({e.first, e.second, true});
+
+	// References to imports
+	vector<unsigned> imports(Labels.size()); // Symbols index + 1 by label
+	vector<bool> imported(Instructions.size());
+	for (const auto& f : Fixups)
+	{	unsigned& sym = imports[f.Label];
+		if (!sym)
+		{	dst.Symbols.push_back({Labels[f.Label].Name, 0, false});
+			sym = dst.Symbols.size();
+		}
+		dst.Relocs.push_back({f.Inst, sym, InstFlags[f.Inst] & IF_ABSOLUTE ? Object::R_ABS : Object::R_REL});
+		imported[f.Inst] = true;
+	}
+	// Absolute addresses of local labels
+	for (unsigned i = 0; i < Instructions.size(); ++i)
+		if ((InstFlags[i] & IF_ABSOLUTE) && !imported[i])
+			dst.Relocs.push_back({i, 0, Object::R_ABS});
+	sort(dst.Relocs.begin(), dst.Relocs.end(), [](const Object::relocation& l, const Object::relocation& r) { return l.Inst < r.Inst; });
+}
+
+void Parser::GetDebugMap(DebugMap& dst)
+{
+	EnsurePass2();
+
+	dst.Files.clear();
+	dst.Contexts.clear();
+	dst.Labels.clear();
+	dst.Ranges.clear();
+
+	// Contexts, drop the ones without location like enrichMsg does.
+	// Their type still applies to the next outer context.
+	unordered_map<ident,uint32_t> files;
+	vector<uint32_t> up(DebugChains.size());          // Contexts index + 1 of the entry or its next outer context
+	vector<contextType> via(DebugChains.size());      // Type to apply to the next outer context
+	for (size_t i = 0; i < DebugChains.size(); ++i)
+	{	const chainEntry& e = DebugChains[i];
+		uint32_t parent = e.Parent ? up[e.Parent - 1] : 0;
+		contextType type = e.Parent && !DebugChains[e.Parent - 1].Line ? via[e.Parent - 1] : e.Type;
+		if (!e.Line)
+		{	up[i] = parent;
+			via[i] = type;
+			continue;
+		}
+		auto file = files.emplace(e.File, dst.Files.size());
+		if (file.second)
+			dst.Files.push_back(FileNames.Name(e.File));
+		DebugMap::contextType dtype;
+		switch (type)
+		{default:
+			dtype = DebugMap::C_INCLUDE; break;
+		 case CTX_MACRO:
+			dtype = DebugMap::C_MACRO; break;
+		 case CTX_FUNCTION:
+			dtype = DebugMap::C_FUNCTION; break;
+		 case CTX_REP:
+			dtype = DebugMap::C_REP; break;
+		}
+		dst.Contexts.push_back({parent, dtype, file.first->second, e.Line});
+		up[i] = dst.Contexts.size();
+		via[i] = e.Type;
+	}
+
+	// Merge consecutive instructions with the same location.
+	vector<uint32_t> labels(Labels.size()); // dst.Labels index + 1 by label
+	size_t count = min(DebugLines.size(), Instructions.size());
+	for (size_t i = 0; i < count; ++i)
+	{	const debugLine& line = DebugLines[i];
+		uint32_t ctx = line.Chain ? up[line.Chain - 1] : 0;
+		uint32_t lbl = 0;
+		if (line.Label)
+		{	lbl = labels[line.Label - 1];
+			if (!lbl)
+			{	const label& l = Labels[line.Label - 1];
+				dst.Labels.push_back({l.Name, l.Value});
+				lbl = labels[line.Label - 1] = dst.Labels.size();
+			}
+		}
+		if (dst.Ranges.size())
+		{	const DebugMap::range& last = dst.Ranges.back();
+			if (last.Context == ctx && last.Column == line.Column && last.Label == lbl)
+				continue;
+		}
+		dst.Ranges.push_back({(uint32_t)i, ctx, line.Column, lbl});
+	}
+}
+
+void Parser::GetDependencies(vector<dependency>& dst) const
+{	dst.clear();
+	for (const auto& source : Sources)
+	{	const sourceFile* src = source.second.get();
+		if (!src)
+			dst.push_back({source.first, false, 0, fileStamp()});
+		else
+			dst.push_back({source.first, true, hash64(src->text(), src->Data ? src->Content.size() : src->Text.size()), src->Stamp});
+	}
+}
@@ -14,9 +14,13 @@
 
 #include <inttypes.h>
 #include <vector>
+#include <deque>
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <string.h>
 #include <stdarg.h>
 
@@ -41,18 +45,43 @@ inline T* binary_search(T (&arr)[N], const char* key)
 	return nohit ? NULL : arr + r;
 }
 
+class Object;
+class DebugMap;
+
 class Parser
-{public:
+{	friend struct tableBench;
+ public:
 	enum severity
 	{	ERROR
 	,	WARNING
 	,	INFO
 	};
+	/// Message prefix by severity, e.g. "ERROR: ".
+	static const char MsgPrefix[][10];
+	/// Source file that has been looked up, see GetDependencies.
+	struct dependency
+	{	string         File;        ///< File name as passed to the file system
+		bool           Exists;      ///< false: the file has been searched but not found
+		uint64_t       Hash;        ///< hash64 of the content if Exists
+		fileStamp      Stamp;       ///< File version that has been used, only from the file system
+	};
  public:
 	bool Success = true;
 	bool Extensions = false;
 	FILE* Preprocessed = NULL;
 	severity Verbose = WARNING;
+	vector<string> IncludePaths; ///< Additional directories to search for .include files
+	/// Keep references to undefined labels as imports of a relocatable object, see GetObject.
+	bool Relocatable = false;
+	/// Absolute code addresses are patched at load time, see GetRelocations.
+	bool PositionIndependent = false;
+	/// Record the source location of each instruction, see GetDebugMap.
+	bool DebugInfo = false;
+	/// Receives all messages. Messages are written to stderr if not set.
+	std::function<void(severity level, const string& msg)> OnMessage;
+	/// Provides the content of source files instead of the file system if set.
+	/// The callback returns false if the file does not exist.
+	std::function<bool(const string& file, string& text)> Reader;
  private:
 	enum token_t : char
 	{	END    =  0 ///< End of line
@@ -68,6 +97,67 @@ class Parser
 	,	SEMI   = ';'
 	,	COLON  = ':'
 	};
+	/// Interned identifier, see identPool. 0 is the empty name.
+	typedef uint32_t ident;
+	/// Process wide pool of names, used for identifiers and file names.
+	/// The ids are part of the cached tokens, so they are shared by all parser instances.
+	/// Lookups by name lock only one of several shards, lookups by id do not lock at all.
+	class identPool
+	{	static const unsigned ShardCount = 64;
+		static const unsigned BlockBits = 12;
+		static const unsigned BlockCount = 4096; ///< Up to 16M names
+		struct shard
+		{	mutex          Lock;
+			unordered_map<string,ident> Ids;
+			string         Key;         ///< Lookup buffer
+		};
+		typedef atomic<const string*> slot;
+		shard          Shards[ShardCount];
+		/// Names by id in blocks of 1<<BlockBits entries that never move, point to the keys of Ids.
+		atomic<slot*>  Blocks[BlockCount];
+		atomic<ident>  Count;
+		/// Make a name available to Name.
+		void           publish(ident id, const string* name);
+	 public:
+		identPool();
+		~identPool();
+		/// Get the id of a name.
+		ident          Intern(const char* name, size_t len);
+		ident          Intern(const string& name) { return Intern(name.c_str(), name.size()); }
+		/// Get the name of an id.
+		const string&  Name(ident id) const { return *Blocks[id >> BlockBits].load(memory_order_acquire)[id & ((1 << BlockBits) - 1)].load(memory_order_acquire); }
+		/// Number of ids.
+		ident          Size() const { return Count.load(memory_order_relaxed); }
+		/// Drop the names that are no longer used and renumber the remaining ones in order.
+		/// Must not be called while other threads use the pool.
+		/// @param used Ids to keep.
+		/// @param remap [out] New id by old id, only valid for used ids.
+		void           Compact(const vector<bool>& used, vector<ident>& remap);
+	};
+	/// Token of a source line.
+	struct token
+	{	token_t        Type;
+		uint8_t        Arg;         ///< Macro argument index + 1 or 0 if the token is no macro argument
+		uint32_t       Len;         ///< Length of the token text
+		uint32_t       Pos;         ///< Offset of the token within the line
+		ident          Id;          ///< Interned text of WORD tokens, 0 otherwise
+	};
+	typedef vector<token> tokens_t;
+	struct sourceLine
+	{	unsigned       Text;        ///< Offset of the line in lineBuffer::Text
+		unsigned       Tokens;      ///< Index of the first token in lineBuffer::Tokens
+	};
+	/// Pre-lexed lines of a source file or macro body.
+	struct lineBuffer
+	{	const char*    Data = NULL; ///< Text of all lines, each terminated by '\n', NULL: use Text
+		string         Text;        ///< Text if not owned by someone else
+		tokens_t       Tokens;      ///< Tokens of all lines, each line terminated by END
+		vector<sourceLine> Lines;
+		const char*    text() const { return Data ? Data : Text.c_str(); }
+		/// Append a line and its tokens. WORD tokens that match args get their argument index.
+		void           append(const char* line, const token* tokens, const vector<ident>& args);
+		void           clear() { Data = NULL; Text.clear(); Tokens.clear(); Lines.clear(); }
+	};
 	static const struct opInfo
 	{	char        Name[4];
 		Eval::mathOp Op;
@@ -108,6 +198,7 @@ class Parser
 	,	CTX_INCLUDE
 	,	CTX_MACRO
 	,	CTX_FUNCTION
+	,	CTX_REP
 	, CTX_CURRENT
 	};
 	enum preprocType
@@ -139,9 +230,9 @@ class Parser
 	static const opEntry<8> directiveMap[];
 
 	struct location
-	{	string         File;
+	{	ident          File;        ///< Id in FileNames
 		unsigned       Line;
-		location()     : Line(0) {}
+		location()     : File(0), Line(0) {}
 		operator void*() const { return (void*)Line; }
 		bool operator !() const { return !Line; }
 		string         toString() const;
@@ -151,10 +242,17 @@ class Parser
 		unsigned       Value;
 		location       Definition;
 		location       Reference;
+		bool           Import = false;///< Undefined label of a relocatable object
 		label(const string& name) : Name(name), Value(0) {}
 	};
 	typedef vector<label> labels_t;
-	typedef unordered_map<string,unsigned> lnames_t;
+	/// Forward label reference to be resolved when the label is defined.
+	struct fixup
+	{	unsigned       Inst;        ///< Index of the instruction, the label value is added to the immediate value
+		unsigned       Label;       ///< Index of the label
+	};
+	typedef vector<fixup> fixups_t;
+	typedef unordered_map<ident,unsigned> lnames_t;
 	enum defFlags : unsigned char
 	{	C_NONE  = 0
 	,	C_LOCAL = 1
@@ -163,17 +261,53 @@ class Parser
 	struct constDef
 	{	exprValue      Value;
 		location       Definition;
-		constDef(const exprValue& value, const location& loc) : Value(value), Definition(loc) {}
+		unsigned       Fixup;       ///< Label index + 1 if Value is relative to a label undefined at the time of assignment
+		constDef(const exprValue& value, const location& loc, unsigned fixup = 0) : Value(value), Definition(loc), Fixup(fixup) {}
+	};
+	/// Constant of a context.
+	struct constEntry
+	{	ident          Name;        ///< 0 if the constant has been removed by .unset
+		constDef       Def;
+	};
+	/// Constants of a context in order of definition.
+	/// They are looked up by Symbols, so no index is required here.
+	/// The deque keeps the definitions in place since Symbols and fileContext::Args refer to them.
+	typedef deque<constEntry> consts_t;
+	/// Operation of a compiled function body.
+	/// The operations feed an Eval instance, so operator precedence is still resolved by Eval.
+	struct funcOp
+	{	enum opType : unsigned char
+		{	VALUE          ///< Push Value
+		,	ARG            ///< Push the function argument number Index
+		,	SYMBOL         ///< Push the constant Name, if there is none push Value if it is a register
+		,	OPERATOR       ///< Push operator Op
+		,	CALL           ///< Call function Name, the following Index arguments are terminated by RETURN
+		,	RETURN         ///< End of a function argument or the function body
+		}              Type;
+		Eval::mathOp   Op = Eval::NOP;
+		unsigned       Index = 0;
+		exprValue      Value;
+		ident          Name = 0;
+		funcOp(opType type) : Type(type) {}
 	};
-	typedef unordered_map<string,constDef> consts_t;
 	struct function
 	{	location       Definition;
-		vector<string> Args;
+		vector<ident>  Args;
 		string         DefLine;
-		char*          Start;
-		function(const location& definition) : Definition(definition), Start(NULL) {}
+		tokens_t       Body;        ///< Tokens of the function body within DefLine
+		vector<funcOp> Code;        ///< Compiled function body, empty if the body needs the parser
+		function(const location& definition) : Definition(definition) {}
+	};
+	/// Invocation of a compiled function.
+	struct funcFrame
+	{	const function& Func;
+		const exprValue* Args;
+		const funcFrame* Parent;      ///< Calling function or NULL
+		/// Find an argument of this or a calling function by name.
+		/// @return Argument value or NULL if there is no such argument.
+		const exprValue* find(ident name) const;
 	};
-	typedef unordered_map<string,function> funcs_t;
+	typedef unordered_map<ident,function> funcs_t;
 	enum macroFlags : unsigned char
 	{	M_NONE = 0
 	,	M_FUNC = 1
@@ -181,10 +315,11 @@ class Parser
 	struct macro
 	{	location       Definition;
 		macroFlags     Flags;
-		vector<string> Args;
-		vector<string> Content;
+		vector<ident>  Args;
+		lineBuffer     Content;
+		uint32_t       Count = 0;   ///< Number of iterations of a .rep block
 	};
-	typedef unordered_map<string,macro> macros_t;
+	typedef unordered_map<ident,macro> macros_t;
 	struct ifContext
 	{	unsigned       Line;
 		unsigned       State;       ///< 0 = .if false, 1 = .if true, 2 = .else, 4 = inherited .false
@@ -192,23 +327,106 @@ class Parser
 	};
 	typedef vector<ifContext> ifs_t;
 	struct fileContext : public location
-	{	const contextType Type;
+	{	contextType    Type;
+		unsigned       Level = 0;   ///< Index in Parser::Context
 		consts_t       Consts;      ///< Constants (.set)
-		fileContext(contextType type, const string& file, unsigned line) : Type(type) { File = file; Line = line; }
+		vector<constDef*> Args;     ///< Macro arguments in Consts by index, see token::Arg
+		fileContext(contextType type, ident file, unsigned line) : Type(type) { File = file; Line = line; }
 	};
 	typedef vector<unique_ptr<fileContext>> contexts_t;
+	/// Definition of a constant in one context.
+	struct binding
+	{	unsigned       Level;       ///< fileContext::Level of the defining context
+		constDef*      Def;         ///< Definition in fileContext::Consts
+	};
+	/// Visible constants by name. The bindings of each name are ordered by Level,
+	/// the innermost one last.
+	typedef unordered_map<ident,vector<binding>> symbols_t;
+	/// Constant read by an invocation from outside its context.
+	struct memoRead
+	{	ident          Name;
+		unsigned       Level;       ///< fileContext::Level of the binding, 0 if there is no constant
+		exprValue      Value;       ///< Value of the constant, V_NONE if there is no constant
+	};
+	/// Invocation of a function or functional macro.
+	struct memoKey
+	{	const void*    Func;        ///< function or macro definition
+		vector<exprValue> Args;
+		bool operator==(const memoKey& r) const;
+	};
+	struct memoHash
+	{	size_t operator()(const memoKey& key) const;
+	};
+	/// Memoized result of a pure invocation.
+	/// It is valid as long as the constants it read still have the same values.
+	struct memoEntry
+	{	vector<memoRead> Reads;
+		exprValue      Result;
+	};
+	typedef unordered_map<memoKey,memoEntry,memoHash> memos_t;
+	/// Purity of an invocation in progress.
+	struct memoFrame
+	{	unsigned       Level;       ///< fileContext::Level of the invocation, constants below are read from outside
+		size_t         IfDepth;     ///< AtIf.size() at the invocation
+		bool           Pure = true; ///< No side effects, diagnostics or label references so far
+		vector<memoRead> Reads;     ///< Constants read from outside
+	};
+	/// Track an invocation while it is evaluated.
+	class memoScope
+	{	Parser&        Parent;
+		memoFrame* const Outer;
+		memoFrame      Frame;
+	 public:
+		memoScope(Parser& parent);
+		~memoScope() { Parent.AtMemo = Outer; }
+		/// Complete the invocation, memoize its result if it is pure.
+		void Store(memoKey&& key, const exprValue& result);
+	};
+	/// Snapshot of a context for deferred diagnostics.
+	struct chainEntry
+	{	unsigned       Parent;      ///< Chains index + 1 of the enclosing context, 0 for the root
+		contextType    Type;
+		unsigned       Line;
+		ident          File;        ///< Id in FileNames
+	};
+	/// Deferred diagnostic. The text is rendered by renderMsg only when it is emitted.
+	struct diagnostic
+	{	severity       Level;
+		const char*    Format;      ///< printf format, a string literal that identifies the message
+		string         Args;        ///< Arguments, see packArgs
+		unsigned       Chain;       ///< Chains index + 1 of the innermost context
+		unsigned       Column;
+	};
+	/// Source file, read and tokenized once per process.
+	struct sourceFile : lineBuffer
+	{	fileContent    Content;     ///< Mapped file, referenced by Data
+		fileStamp      Stamp;       ///< File version when the file was loaded
+	};
+	typedef shared_ptr<const sourceFile> sourcePtr;
+	/// Source files used by this parser by file name, replayed in pass 2.
+	typedef unordered_map<string,sourcePtr> sources_t;
+	/// Process wide cache of source files by canonical path.
+	struct sourceCache
+	{	mutex          Lock;
+		unordered_map<string,sourcePtr> Files;
+	};
+	/// Push a new context for the lifetime of this object.
+	/// The fileContext instances are recycled in LIFO order to avoid allocations
+	/// for each macro or function invocation.
 	class saveContext
 	{protected:
 		Parser&        Parent;
 	 public:
-		saveContext(Parser& parent, fileContext* ctx);
+		saveContext(Parser& parent, contextType type, ident file, unsigned line);
 		~saveContext();
 	};
 	class saveLineContext : public saveContext
-	{	const string   LineBak;
-		char* const    AtBak;
+	{	const char* const LineBak;
+		const char* const AtBak;
+		const token* const TokenAtBak;
+		const token* const LineTokensBak;
 	 public:
-		saveLineContext(Parser& parent, fileContext* ctx);
+		saveLineContext(Parser& parent, contextType type, ident file, unsigned line);
 		~saveLineContext();
 	};
 	enum InstFlags : uint8_t
@@ -216,6 +434,7 @@ class Parser
 	,	IF_HAVE_NOP      = 1        ///< at least one NOP in the current instruction so far
 	,	IF_CMB_ALLOWED   = 2        ///< Instruction of the following line could be merged
 	,	IF_BRANCH_TARGET = 4        ///< This instruction is a branch target
+	,	IF_ABSOLUTE      = 8        ///< The immediate value is an absolute code address
 	};
 
 	template <typename T, T def>
@@ -230,32 +449,87 @@ class Parser
 
 	// parser working set
 	bool             Pass2 = false;
-	vector<string>   Filenames;
+	bool             NeedPass2 = false;///< Pass 1 used forward references that cannot be fixed up
+	vector<ident>    Filenames;   ///< Root files in FileNames
+	sources_t        Sources;     ///< Tokenized source files, NULL if not found
+	unordered_map<string,string> IncludeNames;///< Resolved .include file names by including file and name
+	static sourceCache SourceCache;
+	static identPool Idents;
+	static identPool FileNames;   ///< File table of all locations
+	static ident     LiveIdents;  ///< Size of Idents after the last CollectIdents
+	static const ident RepMacro;  ///< Name of the pending .rep block in Macros
 
-	char             Line[1024];  ///< Buffer for line input. Well, static size...
-	char*            At = NULL;   ///< Current location within Line
+	const char*      Line = NULL; ///< Current line
+	const char*      At = NULL;   ///< Current location within Line
+	const token*     LineTokens = NULL;///< First token of the current line
+	const token*     TokenAt = NULL;///< Next token of the current line
 	string           Token;       ///< Current token
+	ident            TokenId = 0; ///< Id of the current token if it is a WORD
 	Inst             Instruct;    ///< Current instruction
 	unsigned         PC;          ///< Current program counter
 	// context
 	macro*           AtMacro = NULL;///< Currently at a macro definition
+	/// Thrown by Fail while Combining instead of a message.
+	struct combineConflict {};
+	bool             Combining = false;///< Speculative combine attempt in progress, see tryCombine
 	unsigned         Back = 0;    ///< Insert # instructions in the past
 	ifs_t            AtIf;        ///< List of (nested) if statements.
 	contexts_t       Context;     ///< Include and macro call stack
+	contexts_t       FreeContexts;///< Released contexts for reuse by saveContext
+	symbols_t        Symbols;     ///< Constants of all contexts by name
 	// definitions
 	labels_t         Labels;      ///< Label values
+	fixups_t         Fixups;      ///< Forward references of pass 1
+	unsigned         FixupLabel = 0;///< Label index + 1 of a forward reference in the current instruction
+	bool             AbsLabel = false;///< The immediate value of the current instruction is a label value, see IF_ABSOLUTE
+	vector<diagnostic> Messages;  ///< Messages of pass 1, emitted unless pass 2 is required
+	vector<chainEntry> Chains;    ///< Context snapshots of Messages
+	vector<unsigned> LastChain;   ///< Chains index + 1 of each context level of the last snapshot
+	/// Source location of an instruction, see DebugInfo.
+	struct debugLine
+	{	unsigned       Chain;       ///< DebugChains index + 1
+		unsigned       Column;
+		unsigned       Label;       ///< Labels index + 1 of the last non-local label
+	};
+	vector<chainEntry> DebugChains;///< Context snapshots of DebugLines
+	vector<unsigned> DebugLast;   ///< Like LastChain for DebugChains
+	vector<debugLine> DebugLines; ///< By instruction
+	unsigned         InstColumn = 0;///< Column of the current instruction or directive
+	unsigned         LastLabel = 0;///< Labels index + 1 of the last non-local label
 	unsigned         LabelCount = 0;///< Next free label index
 	lnames_t         LabelsByName;///< Label names
+	vector<ident>    Exports;     ///< Labels exported by .global
 	funcs_t          Functions;   ///< Single line function definitions
 	macros_t         MacroFuncs;  ///< Multi line function definitions
 	macros_t         Macros;      ///< Macros
+	memos_t          Memos;       ///< Results of pure function and functional macro invocations
+	memoFrame*       AtMemo = NULL;///< Innermost invocation in progress
 	// instruction
 	vector_safe<uint64_t,0> Instructions;
 	vector_safe<uint8_t,IF_NONE> InstFlags;
  private:
+	/// Append the location of a context to a message.
+	/// @param type Type of the next inner context or CTX_CURRENT for the innermost one.
+	static void      appendContext(string& msg, contextType type, const string& file, unsigned line, unsigned column);
+	/// Column of the current token.
+	unsigned         column() const { return At - Line - Token.size() + 1; }
+	/// Add the context chain to a message.
 	string           enrichMsg(string msg);
+	/// Snapshot of the context chain.
+	/// @param chains Entries of the snapshots, shared with previous snapshots where possible.
+	/// @param last Entry of each context level of the last snapshot.
+	/// @return chains index + 1 of the innermost context.
+	unsigned         captureChain(vector<chainEntry>& chains, vector<unsigned>& last) const;
+	/// Snapshot of the context chain for deferred diagnostics.
+	unsigned         captureChain() { return captureChain(Chains, LastChain); }
+	/// Render the text of a deferred diagnostic, same result as enrichMsg at the time of the diagnostic.
+	string           renderMsg(const diagnostic& diag) const;
+	/// Discard all deferred diagnostics.
+	void             clearMessages() { Messages.clear(); Chains.clear(); LastChain.clear(); }
 	void             Fail(const char* fmt, ...) PRINTFATTR(2) NORETURNATTR;
 	void             Msg(severity level, const char* fmt, ...) PRINTFATTR(3);
+	/// Pass a message to OnMessage or stderr.
+	void             emitMsg(severity level, const string& msg);
 
 	/// Ensure minimum size of InstFlags array.
 	void             FlagsSize(size_t min);
@@ -263,12 +537,34 @@ class Parser
 
 	void             StoreInstruction(uint64_t value);
 
+	/// Split a line into tokens and append them to dst. The list is always terminated by END.
+	/// The line ends at '\n' or '\0'. Identifiers are interned.
+	static void      Tokenize(const char* line, tokens_t& dst);
+	/// Make a line of a line buffer the current line.
+	void             setLine(const lineBuffer& buffer, const sourceLine& line);
 	token_t          NextToken();
+	/// Id of the current token, other tokens than WORD are interned on demand, e.g. numeric labels.
+	ident            tokenId()    { return TokenId ? TokenId : Idents.Intern(Token); }
+	/// Undo the last call to NextToken.
+	void             pushBack();
+	/// End of the tokens of the current line, i.e. before a comment or line feed.
+	const char*      lineEnd() const;
 	/// Work around for gcc on 32 bit Linux that can't read "0x80000000" with sscanf anymore.
 	/// @return Number of characters parsed.
 	static size_t    parseUInt(const char* src, uint32_t& dst);
+	/// Parse a numeric token.
+	/// @param value [out] Value, the type is set even if the parser fails.
+	/// @return false if text is no valid number.
+	static bool      parseNumber(const string& text, exprValue& value);
+	/// Find a register by name.
+	/// @return Register entry or NULL if there is no such register.
+	static const regEntry* findRegister(const char* name);
 	exprValue        parseElemInt();
-	exprValue        ParseExpression();
+	/// Parse an expression.
+	/// @param fixup Accept a forward label reference plus constant offset in pass 1.
+	/// *fixup receives the label index + 1 in this case, 0 otherwise.
+	/// Any other use of a forward reference requires pass 2.
+	exprValue        ParseExpression(unsigned* fixup = NULL);
 
 	static uint8_t   getSmallImmediate(uint32_t i);
 	static const smiEntry* getSmallImmediateALU(uint32_t i);
@@ -286,7 +582,7 @@ class Parser
 
 	void             doALUTarget(exprValue param, bool mul);
 	Inst::mux        doALUExpr(InstContext ctx);
-	void             doBRASource(exprValue param);
+	void             doBRASource(exprValue param, unsigned fixup);
 
 	// OP codes
 	void             assembleADD(int op);
@@ -297,9 +593,21 @@ class Parser
 	void             assembleSIG(int bits);
 
 	void             ParseInstruction();
+	/// Find an instruction opcode.
+	/// @return Opcode entry or NULL if there is no such opcode.
+	static const opEntry<8>* findOpcode(const char* name);
+	/// Check the constraints at the start of the instruction handler of op,
+	/// i.e. whether op cannot be merged into the current instruction regardless of its arguments.
+	bool             wouldConflict(const opEntry<8>& op);
+	/// Try to merge the instructions of the current line into the previous instruction.
+	/// A failed attempt does not create any diagnostics and does not change anything.
+	/// @param pos Index of the next instruction.
+	/// @return false if the instructions conflict.
+	bool             tryCombine(size_t pos);
 
 	void             defineLabel();
 	void             parseLabel();
+	void             parseGLOBAL(int);
 
 	void             parseDATA(int type);
 	void             beginREP(int);
@@ -308,6 +616,9 @@ class Parser
 	void             endBACK(int);
 	void             parseCLONE(int);
 	void             parseSET(int flags);
+	/// Define a constant in a context unless it already exists there.
+	/// @return Definition of the constant in ctx and whether it is new.
+	pair<constDef*,bool> defineConst(fileContext& ctx, ident name, const constDef& def);
 	void             parseUNSET(int flags);
 	bool             doCondition();
 	void             parseIF(int);
@@ -321,11 +632,53 @@ class Parser
 	void             doMACRO(macros_t::const_iterator m);
 	exprValue        doFUNCMACRO(macros_t::const_iterator m);
 	exprValue        doFUNC(funcs_t::const_iterator f);
+	/// Record a constant read for the current invocation.
+	/// @param b Binding of name, NULL if name is no constant.
+	void             trackRead(ident name, const binding* b);
+	void             trackRead(ident name, unsigned level, const exprValue& value);
+	/// The current invocation has side effects, do not memoize it.
+	void             impure()     { if (AtMemo) AtMemo->Pure = false; }
+	/// Discard all memoized results, e.g. because a function has been redefined.
+	void             clearMemos() { Memos.clear(); impure(); }
+	/// Look up a memoized invocation.
+	/// @param result [out] Memoized result.
+	/// @return true if the result is still valid.
+	bool             lookupMemo(const memoKey& key, exprValue& result);
+	/// Compile an expression of a function body up to ',', an unmatched ')' or the end of the line.
+	/// @param tok [in,out] Current token, receives the token that terminated the expression.
+	/// @return false if the expression needs the parser, e.g. because of label references.
+	static bool      compileExpr(const function& f, const token*& tok, vector<funcOp>& code);
+	/// Compile the body of a function into f.Code if possible.
+	static void      compileFunction(function& f);
+	/// Evaluate compiled operations up to the next RETURN.
+	/// @param op [in,out] First operation, receives the terminating RETURN.
+	/// @return false if the evaluation needs the parser.
+	bool             execFunction(const funcOp*& op, const funcFrame& frame, Eval& eval);
+	/// Invoke a compiled function.
+	/// Anything that would raise a diagnostic or depend on parser state is left to doFUNC
+	/// to get exactly the same messages and results.
+	/// @return false if the function needs to be evaluated by the parser.
+	bool             callFunction(const function& f, const exprValue* args, const funcFrame* parent, exprValue& result);
 	void             doINCLUDE(int);
 	bool             doPreprocessor(preprocType type = PP_ALL);
 	void             ParseDirective();
 
 	void             ParseLine();
+	/// Tokenize all lines of data into buffer.
+	static void      tokenizeAll(lineBuffer& buffer, const char* data, size_t size);
+	/// Get the tokenized content of a file from the process wide cache.
+	/// The file is read again only if its modification time or size changed.
+	/// @return NULL on error.
+	static sourcePtr getSource(const string& file);
+	/// Get the tokenized content of a file by Reader or from the file system.
+	/// The same content is used for both passes.
+	/// @return NULL if the file does not exist.
+	sourcePtr        findSource(const string& file);
+	/// Like findSource but fails if the file does not exist.
+	const lineBuffer& loadFile(const string& file);
+	/// Locate the file of an .include directive. Relative names are searched
+	/// relative to the current file first and then in IncludePaths.
+	const string&    resolveInclude(const string& name);
 	void             ParseFile();
 
 	void             ResetPass();
@@ -334,7 +687,28 @@ class Parser
 	                 Parser();
   void             Reset();
 	void             ParseFile(const string& file);
+	/// Release the names of source files that are no longer cached.
+	/// Only does something if the name pools have grown significantly since the last call.
+	/// Must not be called while any parser is in use, e.g. call it between the requests of a server.
+	static void      CollectIdents();
 	const vector<uint64_t>& GetInstructions();
+	/// Get the names and values of all defined labels in order of definition.
+	void             GetLabels(vector<pair<string,unsigned>>& dst);
+	/// Get the names and values of the labels exported by .global in order of declaration.
+	void             GetExports(vector<pair<string,unsigned>>& dst);
+	/// Get the indices of the instructions whose immediate value is an absolute code address,
+	/// i.e. absolute branches to labels and label values loaded by ldi.
+	/// The values are relative to the start of the code, the loader adds the GPU address.
+	void             GetRelocations(vector<uint32_t>& dst);
+	/// Get the relocatable object of the assembled code, requires Relocatable.
+	/// The labels exported by .global are the symbols of the object,
+	/// undefined labels are imported.
+	void             GetObject(Object& dst);
+	/// Get the source locations of all instructions, requires DebugInfo.
+	void             GetDebugMap(DebugMap& dst);
+	/// Get all source files the result depends on including
+	/// the .include candidates that did not exist.
+	void             GetDependencies(vector<dependency>& dst) const;
 };
 
 #endif // PARSER_H_
@@ -0,0 +1,171 @@
+/*
+ * Server.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Server.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+static volatile sig_atomic_t StopRequest = 0;
+
+static void onSignal(int)
+{	StopRequest = 1;
+}
+
+/// Initialize a socket address.
+/// @return false if the path is too long.
+static bool makeAddress(const string& path, sockaddr_un& addr)
+{	if (path.size() >= sizeof addr.sun_path)
+	{	errno = ENAMETOOLONG;
+		return false;
+	}
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	return true;
+}
+
+/// Read until end of file.
+static bool readAll(int fd, string& dst)
+{	char buf[4096];
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof buf)) != 0)
+	{	if (len < 0)
+		{	if (errno == EINTR)
+				continue;
+			return false;
+		}
+		dst.append(buf, len);
+	}
+	return true;
+}
+
+static bool writeAll(int fd, const char* data, size_t size)
+{	while (size)
+	{	ssize_t len = write(fd, data, size);
+		if (len < 0)
+		{	if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += len;
+		size -= len;
+	}
+	return true;
+}
+
+Server::~Server()
+{	if (Socket >= 0)
+	{	close(Socket);
+		unlink(Path.c_str());
+	}
+}
+
+void Server::serve(int conn)
+{	string request;
+	if (!readAll(conn, request) || request.empty() || request.back() != 0)
+		return;
+	// split into working directory and arguments
+	vector<char*> args;
+	for (size_t pos = 0; pos < request.size(); pos += strlen(&request[pos]) + 1)
+		args.push_back(&request[pos]);
+
+	int result;
+	string log;
+	if (chdir(args[0]) != 0)
+	{	log = stringf("Failed to change to directory %s: %s\n", args[0], strerror(errno));
+		result = 1;
+	} else
+	{	args[0] = (char*)"vc4asm";
+		result = Handler(args, log);
+	}
+
+	string response = stringf("%d\n", result) + log;
+	writeAll(conn, response.data(), response.size());
+}
+
+bool Server::Run()
+{	sockaddr_un addr;
+	if (!makeAddress(Path, addr))
+		return false;
+	Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket < 0)
+		return false;
+	// Replace a stale socket of a previous instance.
+	unlink(Path.c_str());
+	if (bind(Socket, (sockaddr*)&addr, sizeof addr) != 0 || listen(Socket, 16) != 0)
+	{	int err = errno;
+		close(Socket);
+		Socket = -1;
+		errno = err;
+		return false;
+	}
+
+	// Let accept return on signals.
+	struct sigaction sa;
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = &onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	while (!StopRequest)
+	{	int conn = accept(Socket, NULL, NULL);
+		if (conn < 0)
+		{	if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return false;
+		}
+		serve(conn);
+		close(conn);
+	}
+	return true;
+}
+
+bool Server::Request(const string& path, int argc, char** argv, int& result)
+{	sockaddr_un addr;
+	if (!makeAddress(path, addr))
+		return false;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+	if (connect(fd, (sockaddr*)&addr, sizeof addr) != 0)
+	{	close(fd);
+		return false;
+	}
+
+	char* cwd = getcwd(NULL, 0);
+	string request(cwd ? cwd : ".");
+	free(cwd);
+	request += '\0';
+	for (int i = 0; i < argc; ++i)
+	{	request += argv[i];
+		request += '\0';
+	}
+	string response;
+	signal(SIGPIPE, SIG_IGN);
+	bool ok = writeAll(fd, request.data(), request.size())
+		&& shutdown(fd, SHUT_WR) == 0
+		&& readAll(fd, response);
+	close(fd);
+
+	char* ep;
+	result = strtol(response.c_str(), &ep, 10);
+	if (!ok || *ep != '\n')
+	{	fprintf(stderr, "Invalid response from %s.\n", path.c_str());
+		result = 1;
+	} else
+		fputs(ep + 1, stderr);
+	return true;
+}
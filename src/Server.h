@@ -0,0 +1,45 @@
+/*
+ * Server.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+/// Resident assembler listening on a Unix domain socket.
+/// A request consists of the working directory of the client followed by its arguments,
+/// each terminated by '\0'. The client shuts down its sending side after the request.
+/// The response is the exit code in decimal, a line feed and the messages.
+/// Requests are processed one after another in the working directory of the client.
+class Server
+{public:
+	/// Process a request.
+	/// @param args Arguments of the client, args[0] is a name for messages.
+	/// @param log [out] Messages for the client.
+	/// @return Exit code.
+	typedef function<int(vector<char*>& args, string& log)> handler;
+ private:
+	const string     Path;
+	const handler    Handler;
+	int              Socket = -1;
+	void             serve(int conn);
+ public:
+	                 Server(const string& path, const handler& h) : Path(path), Handler(h) {}
+	                 ~Server();
+	/// Process requests until SIGINT or SIGTERM.
+	/// @return false on error, errno is set in this case.
+	bool             Run();
+	/// Send a request to a server and write its messages to stderr.
+	/// @param result [out] Exit code of the request.
+	/// @return false if no server is listening at path.
+	static bool      Request(const string& path, int argc, char** argv, int& result);
+};
+
+#endif // SERVER_H_
@@ -6,6 +6,8 @@
  */
 
 #include "Validator.h"
+#include "utils.h"
+#include <cstdio>
 #include <cstddef>
 #include <cstring>
 #include <cstdarg>
@@ -38,12 +40,16 @@ void Validator::Message(int refloc, const char* fmt, ...)
 		return; // Discard message because of second pass.
 	va_list va;
 	va_start(va, fmt);
-	fputs("Warning: ", stderr);
-	vfprintf(stderr, fmt, va);
+	string msg = vstringf(fmt, va);
 	va_end(va);
-	fprintf(stderr, "\n  instruction at 0x%x\n", BaseAddr + At * sizeof(uint64_t));
+	msg += stringf("\n  instruction at 0x%x", (unsigned)(BaseAddr + At * sizeof(uint64_t)));
 	if (refloc >= 0)
-		fprintf(stderr, "  referring to instruction at 0x%x\n", BaseAddr + refloc * sizeof(uint64_t));
+		msg += stringf("\n  referring to instruction at 0x%x", (unsigned)(BaseAddr + refloc * sizeof(uint64_t)));
+	if (OnMessage)
+		return OnMessage(msg);
+	fputs("Warning: ", stderr);
+	fputs(msg.c_str(), stderr);
+	fputc('\n', stderr);
 }
 
 int Validator::FromMux(Inst::mux m)
@@ -13,11 +13,15 @@
 #include <memory>
 #include <cstdint>
 #include <climits>
+#include <string>
+#include <functional>
 using namespace std;
 
 class Validator
 {public:
 	uint32_t BaseAddr = 0;
+	/// Receives the warnings. Warnings are written to stderr if not set.
+	function<void(const string& msg)> OnMessage;
  private:
 	/// Maximum number of instructions where constraints apply.
 	enum { MAX_DEPEND = 4 };
@@ -0,0 +1,207 @@
+/*
+ * libvc4asm.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "libvc4asm.h"
+#include "Parser.h"
+#include "Validator.h"
+
+#include <new>
+#include <mutex>
+
+using namespace vc4asm;
+
+struct Assembler::impl
+{	Parser         Parse;
+	reader         Reader;
+	string         File;        ///< Name of the main source
+	const string*  Text = NULL; ///< Content of the main source
+	const vector<uint64_t>* Code = NULL;
+	vector<uint32_t> Relocs;
+	vector<pair<string,unsigned>> LabelValues;
+	vector<label>  Labels;
+	vector<diagnostic> Diagnostics;
+	bool           Errors = false;
+	impl(const reader& rd);
+	/// Protects Count.
+	static mutex   Lock;
+	/// Number of existing assemblers.
+	static unsigned Count;
+};
+
+mutex Assembler::impl::Lock;
+unsigned Assembler::impl::Count = 0;
+
+Assembler::impl::impl(const reader& rd)
+:	Reader(rd)
+{	Parse.Reader = [this](const string& file, string& text) -> bool
+	{	if (file == File)
+		{	text = *Text;
+			return true;
+		}
+		return Reader && Reader(file, text);
+	};
+	Parse.OnMessage = [this](Parser::severity level, const string& msg)
+	{	Diagnostics.push_back({(severity)level, msg});
+		if (level == Parser::ERROR)
+			Errors = true;
+	};
+}
+
+Assembler::Assembler(const reader& rd)
+{	{	lock_guard<mutex> lock(impl::Lock);
+		++impl::Count;
+	}
+	Impl.reset(new impl(rd));
+}
+
+Assembler::~Assembler()
+{	Impl.reset();
+	lock_guard<mutex> lock(impl::Lock);
+	if (--impl::Count == 0)
+		// No parser is active any more.
+		Parser::CollectIdents();
+}
+
+void Assembler::SetVerbose(severity level)
+{	Impl->Parse.Verbose = (Parser::severity)level;
+}
+
+bool Assembler::Assemble(const string& file, const string& text, bool validate)
+{	impl& d = *Impl;
+	d.Parse.Reset();
+	d.Labels.clear();
+	d.Relocs.clear();
+	d.Diagnostics.clear();
+	d.Errors = false;
+	d.Code = NULL;
+	d.File = file;
+	d.Text = &text;
+
+	try
+	{	d.Parse.ParseFile(file);
+		if (d.Parse.Success)
+		{	d.Code = &d.Parse.GetInstructions();
+			d.Parse.GetRelocations(d.Relocs);
+			d.Parse.GetLabels(d.LabelValues);
+			for (const auto& l : d.LabelValues)
+				d.Labels.push_back({l.first, l.second});
+			if (validate && !d.Errors)
+			{	Validator v;
+				v.OnMessage = [&d](const string& msg)
+				{	d.Diagnostics.push_back({VC4ASM_WARNING, msg});
+				};
+				v.Validate(*d.Code);
+			}
+		}
+	} catch (const string& msg)
+	{	d.Diagnostics.push_back({VC4ASM_ERROR, msg});
+		d.Errors = true;
+	}
+	d.Text = NULL;
+	if (!d.Parse.Success)
+		d.Errors = true;
+	if (d.Errors)
+	{	d.Code = NULL;
+		d.Relocs.clear();
+	}
+	return !d.Errors;
+}
+
+const vector<uint64_t>& Assembler::Instructions() const
+{	static const vector<uint64_t> empty;
+	return Impl->Code ? *Impl->Code : empty;
+}
+
+const vector<uint32_t>& Assembler::Relocations() const
+{	return Impl->Relocs;
+}
+
+const vector<Assembler::label>& Assembler::Labels() const
+{	return Impl->Labels;
+}
+
+const vector<Assembler::diagnostic>& Assembler::Diagnostics() const
+{	return Impl->Diagnostics;
+}
+
+
+struct vc4asm_context
+{	Assembler      Asm;
+	vc4asm_reader  Reader;
+	void*          User;
+	vc4asm_context(vc4asm_reader reader, void* user);
+};
+
+vc4asm_context::vc4asm_context(vc4asm_reader reader, void* user)
+:	Asm([this](const string& file, string& text) -> bool
+	{	const char* data;
+		size_t size;
+		if (!Reader || !Reader(User, file.c_str(), &data, &size))
+			return false;
+		text.assign(data, size);
+		return true;
+	})
+,	Reader(reader)
+,	User(user)
+{}
+
+vc4asm_context* vc4asm_create(vc4asm_reader reader, void* user)
+{	return new (nothrow) vc4asm_context(reader, user);
+}
+
+void vc4asm_destroy(vc4asm_context* ctx)
+{	delete ctx;
+}
+
+void vc4asm_set_verbose(vc4asm_context* ctx, vc4asm_severity level)
+{	ctx->Asm.SetVerbose(level);
+}
+
+int vc4asm_assemble(vc4asm_context* ctx, const char* file, const char* text, size_t size, int validate)
+{	try
+	{	return ctx->Asm.Assemble(file, string(text, size), !!validate);
+	} catch (...)
+	{	return 0;
+	}
+}
+
+const uint64_t* vc4asm_code(const vc4asm_context* ctx, size_t* count)
+{	const auto& code = ctx->Asm.Instructions();
+	*count = code.size();
+	return code.data();
+}
+
+const uint32_t* vc4asm_relocations(const vc4asm_context* ctx, size_t* count)
+{	const auto& relocs = ctx->Asm.Relocations();
+	*count = relocs.size();
+	return relocs.data();
+}
+
+size_t vc4asm_label_count(const vc4asm_context* ctx)
+{	return ctx->Asm.Labels().size();
+}
+
+const char* vc4asm_label(const vc4asm_context* ctx, size_t index, uint32_t* value)
+{	const auto& labels = ctx->Asm.Labels();
+	if (index >= labels.size())
+		return NULL;
+	if (value)
+		*value = labels[index].Value;
+	return labels[index].Name.c_str();
+}
+
+size_t vc4asm_diagnostic_count(const vc4asm_context* ctx)
+{	return ctx->Asm.Diagnostics().size();
+}
+
+const char* vc4asm_diagnostic(const vc4asm_context* ctx, size_t index, vc4asm_severity* level)
+{	const auto& diags = ctx->Asm.Diagnostics();
+	if (index >= diags.size())
+		return NULL;
+	if (level)
+		*level = diags[index].Level;
+	return diags[index].Text.c_str();
+}
@@ -0,0 +1,110 @@
+/*
+ * libvc4asm.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef LIBVC4ASM_H_
+#define LIBVC4ASM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Assembler context. A context can be used for any number of assemblies,
+/// but only by one thread at a time.
+typedef struct vc4asm_context vc4asm_context;
+
+typedef enum
+{	VC4ASM_ERROR
+,	VC4ASM_WARNING
+,	VC4ASM_INFO
+} vc4asm_severity;
+
+/// Callback that provides the content of a source file.
+/// The library never accesses the file system by itself.
+/// @param user User data passed to vc4asm_create.
+/// @param file Name of the file. Relative .include names are already combined
+/// with the directory part of the including file name.
+/// @param text [out] Content of the file. It is copied before the next call.
+/// @param size [out] Length of the content in bytes.
+/// @return Nonzero if the file exists.
+typedef int (*vc4asm_reader)(void* user, const char* file, const char** text, size_t* size);
+
+/// Create an assembler context.
+/// @param reader Callback for .include files, may be NULL if there are none.
+/// @return New context or NULL if out of memory.
+vc4asm_context* vc4asm_create(vc4asm_reader reader, void* user);
+/// Destroy an assembler context.
+/// The names of all identifiers ever assembled are shared by the contexts and only
+/// released when the last context is destroyed. Long running applications that
+/// assemble many different sources should not keep a context forever.
+void            vc4asm_destroy(vc4asm_context* ctx);
+/// Discard messages of lower severity. Default: VC4ASM_WARNING.
+void            vc4asm_set_verbose(vc4asm_context* ctx, vc4asm_severity level);
+/// Assemble source text.
+/// @param file Name of the source used in messages and to resolve relative includes.
+/// @param validate Nonzero: run the instruction verifier and report its warnings as diagnostics.
+/// @return Nonzero on success, zero if there are errors.
+int             vc4asm_assemble(vc4asm_context* ctx, const char* file, const char* text, size_t size, int validate);
+
+// Results of the last assembly, valid until the next call to vc4asm_assemble or vc4asm_destroy.
+/// Get the QPU instructions.
+const uint64_t* vc4asm_code(const vc4asm_context* ctx, size_t* count);
+/// Get the indices of the instructions with absolute code addresses, see vc4reloc.h.
+const uint32_t* vc4asm_relocations(const vc4asm_context* ctx, size_t* count);
+size_t          vc4asm_label_count(const vc4asm_context* ctx);
+/// Get name and value (byte offset) of a label.
+const char*     vc4asm_label(const vc4asm_context* ctx, size_t index, uint32_t* value);
+size_t          vc4asm_diagnostic_count(const vc4asm_context* ctx);
+/// Get the text and optionally the severity of a message.
+const char*     vc4asm_diagnostic(const vc4asm_context* ctx, size_t index, vc4asm_severity* level);
+
+#ifdef __cplusplus
+} // extern "C"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+
+namespace vc4asm
+{
+/// In memory assembler, C++ interface of vc4asm_context.
+class Assembler
+{public:
+	typedef vc4asm_severity severity;
+	struct label
+	{	std::string    Name;
+		uint32_t       Value;       ///< Byte offset
+	};
+	struct diagnostic
+	{	severity       Level;
+		std::string    Text;
+	};
+	/// Provides the content of .include files, see vc4asm_reader.
+	typedef std::function<bool(const std::string& file, std::string& text)> reader;
+ private:
+	struct impl;
+	std::unique_ptr<impl> Impl;
+ public:
+	explicit         Assembler(const reader& rd = reader());
+	/// Releases the shared identifier names if this is the last assembler, see vc4asm_destroy.
+	                 ~Assembler();
+	void             SetVerbose(severity level);
+	/// Assemble source text. The results are valid until the next call.
+	/// @return false if there are errors.
+	bool             Assemble(const std::string& file, const std::string& text, bool validate = false);
+	const std::vector<uint64_t>& Instructions() const;
+	const std::vector<uint32_t>& Relocations() const;
+	const std::vector<label>& Labels() const;
+	const std::vector<diagnostic>& Diagnostics() const;
+};
+} // namespace vc4asm
+
+#endif // __cplusplus
+
+#endif // LIBVC4ASM_H_
@@ -0,0 +1,116 @@
+/*
+ * phash.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef PHASH_H_
+#define PHASH_H_
+
+#include <inttypes.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+/// Smallest power of 2 not less than n.
+constexpr size_t phash_pow2(size_t n, size_t p = 1)
+{	return p >= n ? p : phash_pow2(n, p << 1);
+}
+
+template <typename A> class perfect_hash;
+
+/// Perfect hash index over a constant, ordered table whose entries start with their name,
+/// e.g. perfect_hash<decltype(regMap)>.
+/// The index is built by the hash and displace method when the object is constructed.
+/// A lookup costs one hash of the key, two table accesses and one string compare.
+/// For duplicate names the first entry is found, like binary_search does.
+template <typename T, size_t N>
+class perfect_hash<T[N]>
+{	static_assert(N < 0xffff, "Table too large for 16 bit index.");
+	/// Number of slots, load factor at most 1/2.
+	static constexpr size_t Slots = phash_pow2(2 * N);
+	/// Number of buckets, 2 keys per bucket on average.
+	static constexpr size_t Buckets = N / 2 + 1;
+
+	T*             Table;
+	uint16_t       Disp[Buckets];///< Displacement of each bucket
+	uint16_t       Index[Slots];///< Table index + 1 or 0 if empty
+
+	static const char* name(const T* entry) { return (const char*)entry; }
+	/// FNV-1a hash of a string.
+	static uint32_t hash(const char* key)
+	{	uint32_t h = 2166136261U;
+		while (*key)
+			h = (h ^ (uint8_t)*key++) * 16777619U;
+		return h;
+	}
+	static size_t  bucket(uint32_t h) { return h % Buckets; }
+	static size_t  slot(uint32_t h, unsigned disp)
+	{	h ^= disp * 0x9e3779b9U;
+		h ^= h >> 16;
+		h *= 0x85ebca6bU;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35U;
+		h ^= h >> 16;
+		return h & (Slots - 1);
+	}
+ public:
+	perfect_hash(T (&table)[N]);
+	/// Find the first entry with name key.
+	/// @return Entry or NULL if there is no such entry.
+	T*             find(const char* key) const
+	{	uint32_t h = hash(key);
+		unsigned i = Index[slot(h, Disp[bucket(h)])];
+		return i-- && strcmp(key, name(Table + i)) == 0 ? Table + i : NULL;
+	}
+};
+
+template <typename T, size_t N>
+perfect_hash<T[N]>::perfect_hash(T (&table)[N])
+:	Table(table)
+{	memset(Index, 0, sizeof Index);
+	memset(Disp, 0, sizeof Disp);
+
+	// Distribute keys into buckets, skip duplicates
+	vector<uint32_t> hashes(N);
+	vector<vector<uint16_t>> buckets(Buckets);
+	for (size_t i = 0; i < N; ++i)
+	{	if (i && strcmp(name(table + i), name(table + i - 1)) == 0)
+			continue;
+		hashes[i] = hash(name(table + i));
+		buckets[bucket(hashes[i])].push_back(i);
+	}
+
+	// Place large buckets first
+	vector<uint16_t> order(Buckets);
+	for (size_t b = 0; b < Buckets; ++b)
+		order[b] = b;
+	stable_sort(order.begin(), order.end(),
+		[&buckets](uint16_t l, uint16_t r) { return buckets[l].size() > buckets[r].size(); });
+
+	for (uint16_t b : order)
+	{	const auto& keys = buckets[b];
+		if (keys.empty())
+			break;
+		// Find a displacement that maps all keys of the bucket to empty slots.
+		for (unsigned disp = 0; ; ++disp)
+		{	size_t k;
+			for (k = 0; k < keys.size(); ++k)
+			{	uint16_t& s = Index[slot(hashes[keys[k]], disp)];
+				if (s)
+					break;
+				s = keys[k] + 1;
+			}
+			if (k == keys.size())
+			{	Disp[b] = disp;
+				break;
+			}
+			while (k--)
+				Index[slot(hashes[keys[k]], disp)] = 0;
+		}
+	}
+}
+
+#endif // PHASH_H_
@@ -0,0 +1,77 @@
+/*
+ * phbench.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+// Include the parser implementation to know the size of its tables.
+#include "Parser.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+using namespace std;
+
+/// Compare table lookups by binary_search and perfect_hash.
+struct tableBench
+{	enum { ROUNDS = 20000 };
+	/// Identifiers that are not in any table, e.g. constants and macro arguments.
+	static const char* const Misses[];
+
+	template <typename T, size_t N>
+	static void run(const char* title, T (&table)[N]);
+	static int main();
+};
+
+const char* const tableBench::Misses[] =
+{	"N", "i", "x", "tw16", "rx_ptr", "ra_save_32", "fft_16", "stride", "body_ra_sync", "ra_link_1"
+};
+
+template <typename T, size_t N>
+void tableBench::run(const char* title, T (&table)[N])
+{	perfect_hash<T[N]> index(table);
+
+	vector<const char*> keys;
+	for (const T& entry : table)
+		keys.push_back((const char*)&entry);
+	for (const char* key : Misses)
+		keys.push_back(key);
+
+	// verify
+	for (const char* key : keys)
+		if (index.find(key) != binary_search(table, key))
+		{	fprintf(stderr, "%s: perfect_hash and binary_search disagree on '%s'.\n", title, key);
+			exit(1);
+		}
+
+	typedef chrono::steady_clock clock;
+	size_t hits = 0;
+	auto start = clock::now();
+	for (unsigned r = ROUNDS; r; --r)
+		for (const char* key : keys)
+			hits += binary_search(table, key) != NULL;
+	auto mid = clock::now();
+	for (unsigned r = ROUNDS; r; --r)
+		for (const char* key : keys)
+			hits += index.find(key) != NULL;
+	auto end = clock::now();
+
+	double count = (double)ROUNDS * keys.size();
+	double bs = chrono::duration<double,nano>(mid - start).count() / count;
+	double ph = chrono::duration<double,nano>(end - mid).count() / count;
+	printf("%-14s%5u entries  binary_search %6.1f ns  perfect_hash %6.1f ns  speedup %4.1f (%zu)\n",
+		title, (unsigned)N, bs, ph, bs / ph, hits);
+}
+
+int tableBench::main()
+{	run("opcodeMap", Parser::opcodeMap);
+	run("directiveMap", Parser::directiveMap);
+	run("regMap", Parser::regMap);
+	run("extMap", Parser::extMap);
+	return 0;
+}
+
+int main()
+{	return tableBench::main();
+}
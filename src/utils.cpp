@@ -8,10 +8,19 @@
 #include "utils.h"
 
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 string vstringf(const char* format, va_list va)
-{	int count = vsnprintf(NULL, 0, format, va);
+{	va_list va2;
+	va_copy(va2, va);
+	int count = vsnprintf(NULL, 0, format, va2);
+	va_end(va2);
 	string ret;
 	ret.resize(count);
 	vsnprintf(&ret[0], count+1, format, va);
@@ -25,8 +34,243 @@ string stringf(const char* format, ...)
 	return ret;
 }
 
+/// Argument types of printf conversions.
+enum argType : char
+{	A_NONE
+,	A_INT
+,	A_LONG
+,	A_LLONG
+,	A_SIZE
+,	A_DOUBLE
+,	A_STRING
+,	A_POINTER
+};
+
+/// Find the next conversion of a printf format.
+/// @param end [out] First character after the conversion.
+/// @param type [out] Type of the argument of the conversion.
+/// @return Start of the conversion or NULL if there are no more conversions.
+static const char* nextConversion(const char* format, const char*& end, argType& type)
+{	while ((format = strchr(format, '%')) != NULL)
+	{	if (format[1] == '%')
+		{	format += 2;
+			continue;
+		}
+		const char* cp = format + 1 + strspn(format + 1, "-+ #0123456789.");
+		type = A_INT;
+		for (;; ++cp)
+			switch (*cp)
+			{case 'l':
+				type = type == A_LONG ? A_LLONG : A_LONG; continue;
+			 case 'q':
+			 case 'j':
+			 case 'L':
+				type = A_LLONG; continue;
+			 case 'z':
+			 case 't':
+				type = A_SIZE; continue;
+			 case 'h':
+				continue;
+			 case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+				type = A_DOUBLE; goto done;
+			 case 's':
+				type = A_STRING; goto done;
+			 case 'p':
+				type = A_POINTER; goto done;
+			 case 0:
+				end = cp;
+				type = A_NONE;
+				return format;
+			 default:
+				goto done;
+			}
+	 done:
+		end = cp + 1;
+		return format;
+	}
+	return NULL;
+}
+
+template <typename T>
+static void packValue(string& dst, T value)
+{	dst.append((const char*)&value, sizeof value);
+}
+
+template <typename T>
+static T unpackValue(const char*& src)
+{	T value;
+	memcpy(&value, src, sizeof value);
+	src += sizeof value;
+	return value;
+}
+
+string packArgs(const char* format, va_list va)
+{	string ret;
+	const char* end;
+	argType type;
+	while ((format = nextConversion(format, end, type)) != NULL)
+	{	switch (type)
+		{case A_NONE:
+			break;
+		 case A_INT:
+			packValue(ret, va_arg(va, unsigned)); break;
+		 case A_LONG:
+			packValue(ret, va_arg(va, unsigned long)); break;
+		 case A_LLONG:
+			packValue(ret, va_arg(va, unsigned long long)); break;
+		 case A_SIZE:
+			packValue(ret, va_arg(va, size_t)); break;
+		 case A_DOUBLE:
+			packValue(ret, va_arg(va, double)); break;
+		 case A_POINTER:
+			packValue(ret, va_arg(va, void*)); break;
+		 case A_STRING:
+			{	const char* str = va_arg(va, const char*);
+				if (!str)
+					str = "(null)";
+				size_t len = strlen(str);
+				packValue(ret, len);
+				ret.append(str, len + 1);
+			}
+		}
+		format = end;
+	}
+	return ret;
+}
+
+/// Append a printf format with a single conversion.
+template <typename T>
+static void appendf(string& dst, const char* format, size_t len, T value)
+{	char fmt[128];
+	string longfmt;
+	const char* f = fmt;
+	if (len < sizeof fmt)
+	{	memcpy(fmt, format, len);
+		fmt[len] = 0;
+	} else
+		f = (longfmt.assign(format, len)).c_str();
+	char buf[256];
+	int count = snprintf(buf, sizeof buf, f, value);
+	if ((size_t)count < sizeof buf)
+		dst.append(buf, count);
+	else
+	{	size_t pos = dst.size();
+		dst.resize(pos + count);
+		snprintf(&dst[pos], count + 1, f, value);
+	}
+}
+
+string formatArgs(const char* format, const string& args)
+{	string ret;
+	const char* src = args.data();
+	const char* end;
+	argType type;
+	while (nextConversion(format, end, type))
+	{	// Format the text up to and including the conversion.
+		size_t len = end - format;
+		switch (type)
+		{case A_NONE: // incomplete conversion at the end
+			ret.append(format, len); break;
+		 case A_INT:
+			appendf(ret, format, len, unpackValue<unsigned>(src)); break;
+		 case A_LONG:
+			appendf(ret, format, len, unpackValue<unsigned long>(src)); break;
+		 case A_LLONG:
+			appendf(ret, format, len, unpackValue<unsigned long long>(src)); break;
+		 case A_SIZE:
+			appendf(ret, format, len, unpackValue<size_t>(src)); break;
+		 case A_DOUBLE:
+			appendf(ret, format, len, unpackValue<double>(src)); break;
+		 case A_POINTER:
+			appendf(ret, format, len, unpackValue<void*>(src)); break;
+		 case A_STRING:
+			{	size_t size = unpackValue<size_t>(src);
+				appendf(ret, format, len, src);
+				src += size + 1;
+			}
+		}
+		format = end;
+	}
+	// Remaining text without conversions, only %% to resolve.
+	for (; *format; ++format)
+	{	if (*format == '%' && format[1] == '%')
+			++format;
+		ret += *format;
+	}
+	return ret;
+}
+
 string relpath(const string& context, const string& rel)
 {	if (rel.size() && rel.front() == '/')
 		return rel;
 	return string(context, 0, context.rfind('/')+1) + rel;
 }
+
+uint64_t hash64(const void* data, size_t size, uint64_t h)
+{	const uint8_t* cp = (const uint8_t*)data;
+	const uint8_t* end = cp + size;
+	while (cp != end)
+		h = (h ^ *cp++) * 1099511628211ULL;
+	return h;
+}
+
+bool fileStamp::load(const char* path)
+{	struct stat st;
+	if (stat(path, &st) != 0)
+	{	MTime = 0;
+		Size = -1;
+		return false;
+	}
+	MTime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+	Size = st.st_size;
+	return true;
+}
+
+bool fileContent::load(const char* path)
+{	close();
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{	// Map the file unless it does not end with a line feed.
+		void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED)
+		{	if (((const char*)map)[st.st_size - 1] == '\n')
+			{	::close(fd);
+				Data = (const char*)map;
+				Size = st.st_size;
+				Mapped = true;
+				return true;
+			}
+			munmap(map, st.st_size);
+		}
+	}
+	// Read the file
+	char buf[4096];
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof buf)) > 0)
+		Copy.append(buf, len);
+	int err = errno;
+	::close(fd);
+	if (len < 0)
+	{	Copy.clear();
+		errno = err;
+		return false;
+	}
+	if (Copy.size() && Copy.back() != '\n')
+		Copy.push_back('\n');
+	Data = Copy.data();
+	Size = Copy.size();
+	return true;
+}
+
+void fileContent::close()
+{	if (Mapped)
+		munmap((void*)Data, Size);
+	Mapped = false;
+	Copy.clear();
+	Copy.shrink_to_fit();
+	Data = NULL;
+	Size = 0;
+}
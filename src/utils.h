@@ -10,6 +10,7 @@
 
 #include <string>
 #include <cstdarg>
+#include <inttypes.h>
 using namespace std;
 
 #ifdef __GNUC__
@@ -23,6 +24,47 @@ using namespace std;
 string vstringf(const char* format, va_list va);
 string stringf(const char* format, ...) PRINTFATTR(1);
 
+/// Pack the arguments of a printf format into a byte string to format them later by formatArgs.
+/// Strings are copied, so the arguments need not outlive the result.
+/// The format must not use '*' for width or precision.
+string packArgs(const char* format, va_list va);
+/// Format packed arguments, same result as vstringf with the original arguments.
+string formatArgs(const char* format, const string& args);
+
 string relpath(const string& context, const string& rel);
 
+/// 64 bit FNV-1a hash of a memory block, e.g. to identify the content of a file.
+/// @param h Hash of preceding data to continue with.
+uint64_t hash64(const void* data, size_t size, uint64_t h = 14695981039346656037ULL);
+
+/// Version of a file identified by modification time and size.
+struct fileStamp
+{	int64_t        MTime = 0;   ///< Modification time in ns
+	int64_t        Size = -1;   ///< File size, -1 if the file does not exist
+	/// Get the stamp of a file.
+	/// @return false if the file does not exist.
+	bool           load(const char* path);
+	bool           operator==(const fileStamp& r) const { return MTime == r.MTime && Size == r.Size; }
+	bool           operator!=(const fileStamp& r) const { return !(*this == r); }
+};
+
+/// Read only content of a file, memory mapped if possible.
+/// Non-empty content always ends with '\n'.
+class fileContent
+{	const char*    Data = NULL;
+	size_t         Size = 0;
+	bool           Mapped = false;
+	string         Copy;        ///< Content if the file could not be mapped
+ public:
+	               fileContent() {}
+	               fileContent(const fileContent&) = delete;
+	               ~fileContent() { close(); }
+	/// Load a file.
+	/// @return false on error, errno is set in this case.
+	bool           load(const char* path);
+	void           close();
+	const char*    data() const { return Data; }
+	size_t         size() const { return Size; }
+};
+
 #endif // UTILS_H_
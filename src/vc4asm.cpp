@@ -1,8 +1,23 @@
 #include "Parser.h"
+#include "Object.h"
+#include "DebugMap.h"
+#include "Elf.h"
+#include "Bundle.h"
 #include "Validator.h"
+#include "Cache.h"
+#include "Server.h"
 
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <unistd.h>
 #include <getopt.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_set>
 
 using namespace std;
 
@@ -16,114 +31,625 @@ static inline uint64_t swap_uint64(uint64_t x)
 }
 #endif
 
+static const char Version[] = "V0.1.4";
+
+/// Results of previous requests in resident mode.
+static MemoryCache* Resident = NULL;
+
 static const char CPPTemplate[] = ",\n0x%08lx, 0x%08lx";
 
-int main(int argc, char **argv)
-{
-	const char* outfname = NULL;
-	const char* writeCPP = NULL;
-	const char* writeCPP2 = NULL;
-	const char* writePRE = NULL;
-	bool check = false;
+/// Options and input files of one independent program.
+struct program
+{	const char*    OutFName = NULL;
+	const char*    WriteCPP = NULL;
+	const char*    WriteCPP2 = NULL;
+	const char*    WritePRE = NULL;
+	const char*    WriteOBJ = NULL;
+	const char*    WriteELF = NULL;
+	const char*    WriteHDR = NULL;
+	const char*    WriteREL = NULL;
+	const char*    WriteDBG = NULL;
+	const char*    Name = NULL;     ///< Symbol name for WriteELF and WriteHDR
+	bool           Check = false;
+	const char*    CacheDir = NULL;
+	vector<string> IncludePaths;
+	vector<string> Files;
+	// Batch and resident mode only
+	bool           Collect = false;///< Collect messages in Log rather than writing them to stderr
+	string         Log;
+	bool           Done = false;
+	int            Result = 0;
+	bool           Bundled = false;///< Keep the result in Output for a bundle
+	Cache::result  Output;
+	bool           HasOutput() const { return OutFName || WriteCPP || WriteCPP2 || WritePRE || WriteOBJ || WriteELF || WriteHDR || WriteREL || WriteDBG; }
+};
+
+/// Batch options of the command line.
+struct batch
+{	const char*    Manifest = NULL;
+	unsigned       Threads = 0;
+	const char*    Bundle = NULL;
+};
 
+/// Parse command line options of one program.
+/// @param bat Batch options, NULL if not allowed.
+/// @return false on error.
+static bool parseOptions(int argc, char** argv, program& prog, batch* bat)
+{	optind = 0; // reinitialize getopt
 	int c;
-	while ((c = getopt(argc, argv, "o:c:C:E:V")) != -1)
+	while ((c = getopt(argc, argv, "o:c:C:E:r:e:H:n:p:g:VI:k:j:B:P:")) != -1)
 	{	switch (c)
 		{case 'o':
-			outfname = optarg; break;
+			prog.OutFName = optarg; break;
 		 case 'c':
-			writeCPP = optarg; break;
+			prog.WriteCPP = optarg; break;
 		 case 'C':
-			writeCPP2 = optarg; break;
+			prog.WriteCPP2 = optarg; break;
 		 case 'V':
-			check = true; break;
+			prog.Check = true; break;
 		 case 'E':
-			writePRE = optarg; break;
+			prog.WritePRE = optarg; break;
+		 case 'r':
+			prog.WriteOBJ = optarg; break;
+		 case 'e':
+			prog.WriteELF = optarg; break;
+		 case 'H':
+			prog.WriteHDR = optarg; break;
+		 case 'n':
+			prog.Name = optarg; break;
+		 case 'p':
+			prog.WriteREL = optarg; break;
+		 case 'g':
+			prog.WriteDBG = optarg; break;
+		 case 'I':
+			prog.IncludePaths.emplace_back(optarg); break;
+		 case 'k':
+			prog.CacheDir = optarg; break;
+		 case 'j':
+			if (!bat)
+				goto nobatch;
+			bat->Threads = atoi(optarg); break;
+		 case 'B':
+			if (!bat)
+				goto nobatch;
+			bat->Manifest = optarg; break;
+		 case 'P':
+			if (!bat)
+				goto nobatch;
+			bat->Bundle = optarg; break;
+		 default:
+			return false;
+		 nobatch:
+			fprintf(stderr, "%s: option -%c is not allowed here.\n", argv[0], c);
+			return false;
 		}
 	}
+	while (optind < argc)
+		prog.Files.emplace_back(argv[optind++]);
+	return true;
+}
 
-	if (!outfname && !writeCPP && !writeCPP2 && !writePRE) {
-		fputs("vc4asm V0.1.4\n"
-			"Usage: vc4asm [-o <bin-output>] [-{c|C} <c-output>] [-V] <qasm-file(s)>\n"
-			" -o<file> Binary output file.\n"
-			" -c<file> C output file with trailing ','.\n"
-			" -C<file> C output file withOUT trailing ','.\n"
-			" -V       Run instruction verifier and print warnings about suspicious code.\n"
-			, stderr);
-		return 1;
-	}
+/// Write a message of a program to stderr or to its log.
+static void printMsg(program& prog, const char* fmt, ...) PRINTFATTR(2);
+static void printMsg(program& prog, const char* fmt, ...)
+{	va_list va;
+	va_start(va, fmt);
+	string msg = vstringf(fmt, va);
+	va_end(va);
+	if (prog.Collect)
+		prog.Log += msg;
+	else
+		fputs(msg.c_str(), stderr);
+}
+
+/// Hash of everything but the source files that influences the result of a program.
+static uint64_t commandHash(const program& prog)
+{	char* cwd = getcwd(NULL, 0);
+	string cmd = stringf("vc4asm %s\n%s\n%d\n", Version, cwd ? cwd : "", prog.Check);
+	free(cwd);
+	if (prog.WriteREL)
+		cmd += "-p\n"; // suppresses warnings
+	for (const string& path : prog.IncludePaths)
+		cmd += "-I" + path + '\n';
+	for (const string& file : prog.Files)
+		cmd += file + '\n';
+	return hash64(cmd.data(), cmd.size());
+}
 
+/// Assemble the source files of a program.
+/// @param res [out] Instructions and messages.
+/// @param deps [out] Source files the result depends on.
+/// @param obj [out] Relocatable object, NULL if not requested.
+/// @param dbg [out] Debug map, NULL if not requested.
+/// @return Exit code or -2 if no instructions are available.
+static int parse(program& prog, Cache::result& res, vector<Parser::dependency>& deps, Object* obj, DebugMap* dbg)
+{	int result = 0;
 	Parser parser;
+	parser.IncludePaths = prog.IncludePaths;
+	parser.Relocatable = obj != NULL;
+	parser.DebugInfo = dbg != NULL;
+	parser.PositionIndependent = prog.WriteREL != NULL;
+	parser.OnMessage = [&res](Parser::severity level, const string& msg)
+	{	res.Log += Parser::MsgPrefix[level];
+		res.Log += msg;
+		res.Log += '\n';
+	};
 
-	if (writePRE)
-	{	parser.Preprocessed = fopen(writePRE, "wt");
+	if (prog.WritePRE)
+	{	parser.Preprocessed = fopen(prog.WritePRE, "wt");
 		if (parser.Preprocessed == NULL)
-		{	fprintf(stderr, "Failed to open %s for writing.", writePRE);
+		{	printMsg(prog, "Failed to open %s for writing.\n", prog.WritePRE);
 			return -1;
 		}
 	}
 
 	try
-	{	while (optind < argc)
-		{	parser.ParseFile(argv[optind]);
-			++optind;
-		}
+	{	for (const string& file : prog.Files)
+			parser.ParseFile(file);
 		if (!parser.Success)
 			throw string("Aborted because of earlier errors.");
 
-		if (check)
-		Validator().Validate(parser.GetInstructions());
+		res.Code = parser.GetInstructions();
+		if (prog.WriteREL)
+			parser.GetRelocations(res.Relocs);
+		parser.GetExports(res.Exports);
+		if (obj)
+			parser.GetObject(*obj);
+		if (dbg)
+			parser.GetDebugMap(*dbg);
+		if (prog.Check)
+		{	Validator v;
+			v.OnMessage = [&res](const string& msg)
+			{	res.Log += "Warning: ";
+				res.Log += msg;
+				res.Log += '\n';
+			};
+			v.Validate(res.Code);
+		}
+		parser.GetDependencies(deps);
+		result = !parser.Success;
+	} catch (const string& msg)
+	{	res.Log += msg;
+		res.Log += '\n';
+		result = -2;
+	}
 
-		if (writeCPP)
-		{	FILE* of = fopen(writeCPP, "wt");
-			if (of == NULL)
-			{	fprintf(stderr, "Failed to open %s for writing.", writeCPP);
-				return -1;
-			}
+	if (parser.Preprocessed)
+		fclose(parser.Preprocessed);
+	printMsg(prog, "%s", res.Log.c_str());
+	return result;
+}
 
-			const char* tpl = CPPTemplate + 2; // no ,\n in the first line
-			for (auto code : parser.GetInstructions())
-			{	fprintf(of, tpl, (unsigned long)(code & 0xffffffffULL), (unsigned long)(code >> 32) );
-				tpl = CPPTemplate;
-			}
-			fputs(",\n", of);
-			fclose(of);
-		}
-		if (writeCPP2)
-		{	FILE* of = fopen(writeCPP2, "wt");
-			if (of == NULL)
-			{	fprintf(stderr, "Failed to open %s for writing.", writeCPP2);
-				return -1;
-			}
+/// Symbol name of a program for the ELF and header output and for bundles.
+/// Defaults to the base name of the first output file, e.g. shader_1k for shader_1k.o,
+/// or of the last source file if there is no output file.
+static string symbolName(const program& prog)
+{	string name;
+	if (prog.Name)
+		name = prog.Name;
+	else
+	{	const char* path = prog.WriteELF ? prog.WriteELF : prog.OutFName ? prog.OutFName
+			: prog.WriteHDR ? prog.WriteHDR : prog.Files.back().c_str();
+		const char* cp = strrchr(path, '/');
+		name = cp ? cp + 1 : path;
+		size_t ext = name.find('.');
+		if (ext != string::npos)
+			name.erase(ext);
+	}
+	for (char& c : name)
+		if (!isalnum((unsigned char)c))
+			c = '_';
+	if (name.empty() || isdigit((unsigned char)name[0]))
+		name.insert(0, 1, '_');
+	return name;
+}
+
+/// Escape a string for a C string literal.
+static string cstring(const string& value)
+{	string ret;
+	for (char c : value)
+		switch (c)
+		{case '\n':
+			ret += "\\n"; break;
+		 case '"':
+		 case '\\':
+			ret += '\\';
+		 default:
+			ret += c;
+		}
+	return ret;
+}
+
+/// Write a C header that declares the symbols of the ELF output.
+/// If a binary output is requested as well the header also defines
+/// the macro <NAME>_INCBIN to embed it by a top level __asm__ statement.
+/// @return false on error.
+static bool writeHeader(const program& prog, const string& name, size_t size)
+{	FILE* of = fopen(prog.WriteHDR, "wt");
+	if (of == NULL)
+		return false;
+	string macro = name;
+	for (char& c : macro)
+		c = toupper((unsigned char)c);
+	fprintf(of, "/* Generated by vc4asm %s, do not edit. */\n"
+		"#ifndef %s_H_\n"
+		"#define %s_H_\n\n"
+		"#include <stdint.h>\n\n"
+		"#define %s_SIZE %zu\n\n"
+		"extern const uint32_t %s_start[];\n"
+		"extern const uint32_t %s_end[];\n",
+		Version, macro.c_str(), macro.c_str(), macro.c_str(), size, name.c_str(), name.c_str());
+	if (prog.OutFName)
+	{	// .incbin searches relative to the working directory of the compiler and its -I paths.
+		string incbin = ".incbin \"" + cstring(prog.OutFName) + "\"\n";
+		fprintf(of, "\n"
+			"#define %s_INCBIN \\\n"
+			"\t\".section .rodata\\n\" \\\n"
+			"\t\".balign 8\\n\" \\\n"
+			"\t\".global %s_start\\n\" \\\n"
+			"\t\".global %s_end\\n\" \\\n"
+			"\t\"%s_start:\\n\" \\\n"
+			"\t\"%s\" \\\n"
+			"\t\"%s_end:\\n\" \\\n"
+			"\t\".previous\\n\"\n",
+			macro.c_str(), name.c_str(), name.c_str(), name.c_str(), cstring(incbin).c_str(), name.c_str());
+	}
+	fprintf(of, "\n#endif // %s_H_\n", macro.c_str());
+	return fclose(of) == 0;
+}
+
+/// Write the output files of a program.
+/// @return Exit code.
+static int writeOutputs(program& prog, const Cache::result& res)
+{	const vector<uint64_t>& instructions = res.Code;
+	if (prog.Bundled)
+		prog.Output = res;
+	if (prog.WriteCPP)
+	{	FILE* of = fopen(prog.WriteCPP, "wt");
+		if (of == NULL)
+		{	printMsg(prog, "Failed to open %s for writing.\n", prog.WriteCPP);
+			return -1;
+		}
+
+		const char* tpl = CPPTemplate + 2; // no ,\n in the first line
+		for (auto code : instructions)
+		{	fprintf(of, tpl, (unsigned long)(code & 0xffffffffULL), (unsigned long)(code >> 32) );
+			tpl = CPPTemplate;
+		}
+		fputs(",\n", of);
+		fclose(of);
+	}
+	if (prog.WriteCPP2)
+	{	FILE* of = fopen(prog.WriteCPP2, "wt");
+		if (of == NULL)
+		{	printMsg(prog, "Failed to open %s for writing.\n", prog.WriteCPP2);
+			return -1;
+		}
+
+		const char* tpl = CPPTemplate + 2; // no ,\n in the first line
+		for (auto code : instructions)
+		{	fprintf(of, tpl, (unsigned long)(code & 0xffffffffULL), (unsigned long)(code >> 32) );
+			tpl = CPPTemplate;
+		}
+		fputc('\n', of);
+		fclose(of);
+	}
+
+	if (prog.OutFName)
+	{
+		#if (defined(__BIG_ENDIAN__) && __BIG_ENDIAN__) || (defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN)
+		vector<uint64_t> memory(instructions);
+		for (auto& i : memory)
+			i = swap_uint64(i);
+		#else
+		const vector<uint64_t>& memory = instructions;
+		#endif
+		FILE* of = fopen(prog.OutFName, "wb");
+		if (of == NULL)
+		{	printMsg(prog, "Failed to open %s for writing.\n", prog.OutFName);
+			return -1;
+		}
+		fwrite(memory.data(), sizeof(uint64_t), memory.size(), of);
+		fclose(of);
+	}
+
+	if (prog.WriteELF || prog.WriteHDR)
+	{	string name = symbolName(prog);
+		if (prog.WriteELF && !writeElf(prog.WriteELF, name, instructions))
+		{	printMsg(prog, "Failed to write %s: %s\n", prog.WriteELF, strerror(errno));
+			return -1;
+		}
+		if (prog.WriteHDR && !writeHeader(prog, name, instructions.size() * sizeof(uint64_t)))
+		{	printMsg(prog, "Failed to write %s: %s\n", prog.WriteHDR, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (prog.WriteREL)
+	{	// instruction indices, 32 bit little endian
+		string out;
+		for (uint32_t index : res.Relocs)
+			for (unsigned i = 0; i < 32; i += 8)
+				out.push_back((char)(index >> i));
+		FILE* of = fopen(prog.WriteREL, "wb");
+		if (of == NULL)
+		{	printMsg(prog, "Failed to open %s for writing.\n", prog.WriteREL);
+			return -1;
+		}
+		fwrite(out.data(), 1, out.size(), of);
+		fclose(of);
+	}
+	return 0;
+}
 
-			const char* tpl = CPPTemplate + 2; // no ,\n in the first line
-			for (auto code : parser.GetInstructions())
-			{	fprintf(of, tpl, (unsigned long)(code & 0xffffffffULL), (unsigned long)(code >> 32) );
-				tpl = CPPTemplate;
+/// Assemble one program and write its output files.
+/// @return Exit code.
+static int assemble(program& prog)
+{	Cache::result res;
+	unique_ptr<Cache> cache;
+	uint64_t command = 0;
+	// The preprocessor output, objects and debug maps cannot be restored from the caches.
+	bool cacheable = !prog.WritePRE && !prog.WriteOBJ && !prog.WriteDBG && (Resident || prog.CacheDir);
+	if (cacheable)
+	{	command = commandHash(prog);
+		if (Resident && Resident->Lookup(command, res))
+		{	printMsg(prog, "%s", res.Log.c_str());
+			return writeOutputs(prog, res);
+		}
+		if (prog.CacheDir)
+		{	cache.reset(new Cache(prog.CacheDir));
+			if (cache->Lookup(command, res))
+			{	printMsg(prog, "%s", res.Log.c_str());
+				return writeOutputs(prog, res);
 			}
-			fputc('\n', of);
-			fclose(of);
-		}
-
-		if (outfname)
-		{
-			#if (defined(__BIG_ENDIAN__) && __BIG_ENDIAN__) || (defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN)
-			for (auto& i : memory)
-				i = swap_uint64(i);
-			#endif
-			FILE* of = fopen(outfname, "wb");
-			if (of == NULL)
-			{	fprintf(stderr, "Failed to open %s for writing.", outfname);
-				return -1;
+		}
+	}
+
+	vector<Parser::dependency> deps;
+	Object obj;
+	DebugMap dbg;
+	int result = parse(prog, res, deps, prog.WriteOBJ ? &obj : NULL, prog.WriteDBG ? &dbg : NULL);
+	if (result == -2)
+		return 1;
+	if (result < 0)
+		return result;
+	if (prog.WriteOBJ && !obj.Save(prog.WriteOBJ))
+	{	printMsg(prog, "Failed to write %s: %s\n", prog.WriteOBJ, strerror(errno));
+		return -1;
+	}
+	if (prog.WriteDBG && !dbg.Save(prog.WriteDBG))
+	{	printMsg(prog, "Failed to write %s: %s\n", prog.WriteDBG, strerror(errno));
+		return -1;
+	}
+	if (cacheable && result == 0)
+	{	if (Resident)
+			Resident->Store(command, deps, res);
+		if (cache)
+			cache->Store(command, deps, res);
+	}
+	int written = writeOutputs(prog, res);
+	return written ? written : result;
+}
+
+/// Write the results of a batch into a bundle.
+/// @return Exit code.
+static int bundle(const char* fname, vector<program>& progs)
+{	vector<bundleProgram> programs;
+	unordered_set<string> names;
+	for (program& prog : progs)
+	{	programs.push_back({symbolName(prog), &prog.Output.Code, &prog.Output.Exports});
+		if (!names.insert(programs.back().Name).second)
+		{	fprintf(stderr, "Program name %s is not unique within the bundle, use -n.\n", programs.back().Name.c_str());
+			return 1;
+		}
+	}
+	if (!writeBundle(fname, programs))
+	{	fprintf(stderr, "Failed to write %s: %s\n", fname, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/// Read the manifest of a batch.
+/// Each line contains the options and files of one program like a command line.
+/// Empty lines and lines starting with # are ignored.
+/// @param common Options of the command line, applied to all programs.
+/// @param storage [out] Storage for the option strings.
+/// @return false on error.
+static bool readManifest(const char* fname, const program& common, vector<program>& progs, vector<vector<char>>& storage)
+{	fileContent content;
+	if (!content.load(fname))
+	{	fprintf(stderr, "Failed to read %s: %s\n", fname, strerror(errno));
+		return false;
+	}
+	const char* cp = content.data();
+	const char* end = cp + content.size();
+	unsigned line = 0;
+	while (cp != end)
+	{	const char* eol = (const char*)memchr(cp, '\n', end - cp);
+		if (!eol)
+			eol = end;
+		++line;
+		// split into arguments
+		storage.emplace_back(cp, eol);
+		vector<char>& text = storage.back();
+		text.push_back(0);
+		vector<char*> argv;
+		string name = stringf("%s (%u)", fname, line);
+		argv.push_back(&name[0]);
+		for (char* arg = strtok(&text[0], " \t\r"); arg; arg = strtok(NULL, " \t\r"))
+			argv.push_back(arg);
+		cp = eol == end ? end : eol + 1;
+		if (argv.size() == 1 || *argv[1] == '#')
+			continue;
+
+		progs.emplace_back(common);
+		program& prog = progs.back();
+		prog.Collect = true;
+		if (!parseOptions(argv.size(), &argv[0], prog, NULL))
+			return false;
+		if (prog.Files.empty())
+		{	fprintf(stderr, "%s: no input files.\n", name.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Assemble independent programs on a thread pool.
+/// The messages of each program are written in order of the manifest.
+/// @return Exit code.
+static int assembleAll(vector<program>& progs, unsigned threads)
+{	if (threads == 0)
+		threads = thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	if (threads > progs.size())
+		threads = progs.size();
+
+	atomic<size_t> next(0);
+	mutex lock;
+	condition_variable done;
+	vector<thread> pool;
+	for (unsigned i = 0; i < threads; ++i)
+		pool.emplace_back([&]()
+		{	size_t n;
+			while ((n = next++) < progs.size())
+			{	int result = assemble(progs[n]);
+				lock_guard<mutex> guard(lock);
+				progs[n].Result = result;
+				progs[n].Done = true;
+				done.notify_all();
 			}
-			fwrite(&*parser.GetInstructions().begin(), sizeof(uint64_t), parser.GetInstructions().size(), of);
-			fclose(of);
+		});
+
+	int result = 0;
+	for (program& prog : progs)
+	{	unique_lock<mutex> guard(lock);
+		done.wait(guard, [&prog]() { return prog.Done; });
+		fputs(prog.Log.c_str(), stderr);
+		if (prog.Result)
+			result = 1;
+	}
+	for (thread& t : pool)
+		t.join();
+	return result;
+}
+
+/// Resident mode: process the requests of vc4asm --connect until terminated.
+/// The tokenized source files and the results of unchanged programs are kept in memory.
+/// @param common Options applied to all requests.
+/// @return Exit code.
+static int serve(const char* socket, const program& common)
+{	MemoryCache resident;
+	Resident = &resident;
+	Server server(socket, [&common](vector<char*>& args, string& log) -> int
+	{	program prog(common);
+		prog.Collect = true;
+		if (!parseOptions(args.size(), &args[0], prog, NULL))
+		{	log = "Invalid arguments.\n";
+			return 1;
 		}
-	} catch (const string& msg)
-	{	fputs(msg.c_str(), stderr);
-	  fputc('\n', stderr);
+		if (prog.Files.empty() || !prog.HasOutput())
+		{	log = "No input or output files.\n";
+			return 1;
+		}
+		int result = assemble(prog);
+		log = move(prog.Log);
+		// Requests are processed one after another, so no parser is active here.
+		Parser::CollectIdents();
+		return result;
+	});
+	if (!server.Run())
+	{	fprintf(stderr, "Failed to listen at %s: %s\n", socket, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{	program common;
+	batch bat;
+
+	if (argc >= 3 && strcmp(argv[1], "--serve") == 0)
+	{	// argv[2] takes the role of argv[0]
+		if (!parseOptions(argc - 2, argv + 2, common, NULL))
+			return 1;
+		if (!common.Files.empty() || common.HasOutput())
+		{	fputs("Output files and input files cannot be combined with --serve.\n", stderr);
+			return 1;
+		}
+		return serve(argv[2], common);
+	}
+	if (argc >= 3 && strcmp(argv[1], "--connect") == 0)
+	{	int result;
+		if (Server::Request(argv[2], argc - 3, argv + 3, result))
+			return result;
+		// No server, assemble locally.
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (!parseOptions(argc, argv, common, &bat))
+		return 1;
+
+	if (bat.Manifest)
+	{	if (!common.Files.empty() || common.HasOutput())
+		{	fputs("Output files and input files cannot be combined with -B.\n", stderr);
+			return 1;
+		}
+		vector<program> progs;
+		vector<vector<char>> storage;
+		if (!readManifest(bat.Manifest, common, progs, storage))
+			return 1;
+		for (program& prog : progs)
+			prog.Bundled = bat.Bundle != NULL;
+		int result = assembleAll(progs, bat.Threads);
+		if (result == 0 && bat.Bundle)
+			result = bundle(bat.Bundle, progs);
+		return result;
+	}
+	if (bat.Bundle)
+	{	fputs("-P requires -B.\n", stderr);
+		return 1;
+	}
+
+	if (!common.HasOutput()) {
+		fprintf(stderr, "vc4asm %s\n"
+			"Usage: vc4asm [-o <bin-output>] [-{c|C} <c-output>] [-r <object>] [-e <elf-output>] [-H <header>] [-n <name>] [-p <relocs>] [-g <debug-map>] [-V] [-I <dir>] [-k <dir>] <qasm-file(s)>\n"
+			"       vc4asm [-j <threads>] [-V] [-I <dir>] [-k <dir>] [-P <bundle>] -B <manifest>\n"
+			"       vc4asm --serve <socket> [-V] [-I <dir>] [-k <dir>]\n"
+			"       vc4asm --connect <socket> <options and files as above>\n"
+			" -o<file> Binary output file.\n"
+			" -c<file> C output file with trailing ','.\n"
+			" -C<file> C output file withOUT trailing ','.\n"
+			" -r<file> Relocatable object output for vc4ld. Undefined labels are imported,\n"
+			"          labels declared by .global are exported.\n"
+			" -e<file> ELF object output for the host linker with the code in .rodata\n"
+			"          and the symbols <name>_start, <name>_end and <name>_size.\n"
+			" -H<file> C header output with the declarations for -e or the macro\n"
+			"          <NAME>_INCBIN to embed the binary output of -o by .incbin.\n"
+			" -n<name> Symbol name for -e and -H, default: base name of the output file.\n"
+			" -p<file> Relocation list output, indices of the instructions with absolute\n"
+			"          code addresses as 32 bit little endian integers, see vc4reloc.h.\n"
+			" -g<file> Debug map output with the source location of each instruction\n"
+			"          including the macro, .rep and .include chain, see vc4dis -g.\n"
+			" -V       Run instruction verifier and print warnings about suspicious code.\n"
+			" -I<dir>  Search include files also in <dir>. May be repeated.\n"
+			" -k<dir>  Reuse the results of previous runs with the same sources from the\n"
+			"          cache directory <dir>.\n"
+			" -B<file> Assemble independent programs listed in <file>, one per line\n"
+			"          with the options and files as above.\n"
+			" -j<n>    Number of threads for -B, default: number of CPUs.\n"
+			" -P<file> Write all programs of -B into a bundle for the loader in vc4bundle.h.\n"
+			"          The programs are named by -n or the base name of their output or\n"
+			"          source file, entry labels are declared by .global.\n"
+			" --serve  Run as resident assembler that listens at the Unix domain <socket>.\n"
+			" --connect Let the resident assembler at <socket> do the work,\n"
+			"          assemble locally if there is none.\n"
+			, Version);
 		return 1;
 	}
 
-	return !parser.Success;
+	return assemble(common);
 }
@@ -0,0 +1,187 @@
+/*
+ * vc4bundle.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef VC4BUNDLE_H_
+#define VC4BUNDLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/// Bundle of QPU programs written by vc4asm -B <manifest> -P <bundle>.
+/// The file is used in place by mmap, i.e. programs are found in O(1)
+/// by a hash table over their names and their code is never copied.
+/// All fields are little endian, so the loader requires a little endian host,
+/// otherwise vc4_bundle_open fails.
+///
+///   vc4_bundle b;
+///   if (vc4_bundle_open(&b, "shaders.vc4b") == 0)
+///   {   const vc4_bundle_program* p = vc4_bundle_find(&b, "gpu_fft_1k");
+///       if (p) memcpy(arm_ptr, vc4_bundle_code(&b, p), p->size);
+///   }
+///
+/// Header only, no dependencies beyond POSIX.
+
+#define VC4_BUNDLE_MAGIC "VC4B"
+#define VC4_BUNDLE_VERSION 1
+
+/// File header, followed by the hash table, the programs, the entry labels,
+/// the names and the code. The offsets are relative to the start of the file.
+typedef struct
+{	char           magic[4];     ///< VC4_BUNDLE_MAGIC
+	uint32_t       version;      ///< VC4_BUNDLE_VERSION
+	uint32_t       count;        ///< Number of programs
+	uint32_t       slots;        ///< Size of the hash table, power of 2
+	uint32_t       slot_offset;  ///< uint32_t[slots]: program index + 1, 0 = empty slot
+	uint32_t       program_offset; ///< vc4_bundle_program[count]
+	uint32_t       entry_offset; ///< vc4_bundle_entry[], grouped by program
+	uint32_t       size;         ///< File size
+} vc4_bundle_header;
+
+typedef struct
+{	uint32_t       name;         ///< Offset of the NUL terminated name
+	uint32_t       hash;         ///< vc4_bundle_hash of the name
+	uint32_t       code;         ///< Offset of the code, 8 byte aligned
+	uint32_t       size;         ///< Size of the code in bytes
+	uint32_t       entry;        ///< Index of the first entry label
+	uint32_t       entry_count;  ///< Number of entry labels
+	uint64_t       checksum;     ///< FNV-1a 64 of the code, see vc4_bundle_verify
+} vc4_bundle_program;
+
+/// Label exported by .global
+typedef struct
+{	uint32_t       name;         ///< Offset of the NUL terminated name
+	uint32_t       value;        ///< Byte offset within the code
+} vc4_bundle_entry;
+
+/// Bundle in memory.
+typedef struct
+{	const uint8_t* base;
+	size_t         size;
+} vc4_bundle;
+
+/// FNV-1a 32 of a program name, selects the hash table slot.
+static inline uint32_t vc4_bundle_hash(const char* name)
+{	uint32_t h = 2166136261U;
+	while (*name)
+		h = (h ^ (uint8_t)*name++) * 16777619U;
+	return h;
+}
+
+static inline const vc4_bundle_header* vc4_bundle_hdr(const vc4_bundle* b)
+{	return (const vc4_bundle_header*)b->base;
+}
+
+/// Map a bundle into memory.
+/// @return 0 on success, -1 on error with errno set.
+static inline int vc4_bundle_open(vc4_bundle* b, const char* path)
+{	struct stat st;
+	const vc4_bundle_header* h;
+	int fd = open(path, O_RDONLY);
+	b->base = NULL;
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0)
+	{	close(fd);
+		return -1;
+	}
+	b->size = st.st_size;
+	if (b->size < sizeof(vc4_bundle_header))
+	{	close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	b->base = (const uint8_t*)mmap(NULL, b->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (b->base == (const uint8_t*)MAP_FAILED)
+	{	b->base = NULL;
+		return -1;
+	}
+	h = vc4_bundle_hdr(b);
+	if ( memcmp(h->magic, VC4_BUNDLE_MAGIC, 4) != 0 || h->version != VC4_BUNDLE_VERSION
+		|| h->size != b->size || !h->slots || (h->slots & (h->slots - 1))
+		|| h->slot_offset > b->size || (b->size - h->slot_offset) / sizeof(uint32_t) < h->slots
+		|| h->program_offset > b->size || (b->size - h->program_offset) / sizeof(vc4_bundle_program) < h->count )
+	{	munmap((void*)b->base, b->size);
+		b->base = NULL;
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static inline void vc4_bundle_close(vc4_bundle* b)
+{	if (b->base)
+		munmap((void*)b->base, b->size);
+	b->base = NULL;
+}
+
+/// Name of a program or an entry label.
+static inline const char* vc4_bundle_string(const vc4_bundle* b, uint32_t offset)
+{	return (const char*)b->base + offset;
+}
+
+/// Find a program by name.
+/// @return NULL if there is no such program.
+static inline const vc4_bundle_program* vc4_bundle_find(const vc4_bundle* b, const char* name)
+{	const vc4_bundle_header* h = vc4_bundle_hdr(b);
+	const uint32_t* slots = (const uint32_t*)(b->base + h->slot_offset);
+	const vc4_bundle_program* programs = (const vc4_bundle_program*)(b->base + h->program_offset);
+	uint32_t hash = vc4_bundle_hash(name);
+	uint32_t i, n;
+	// linear probing
+	for (i = hash & (h->slots - 1), n = h->slots; n && slots[i]; i = (i + 1) & (h->slots - 1), --n)
+	{	const vc4_bundle_program* p = programs + slots[i] - 1;
+		if (slots[i] > h->count || p->hash != hash || p->name >= b->size
+			|| strncmp(vc4_bundle_string(b, p->name), name, b->size - p->name) != 0)
+			continue;
+		if (p->code > b->size || b->size - p->code < p->size)
+			return NULL;
+		return p;
+	}
+	return NULL;
+}
+
+/// Code of a program, p->size bytes.
+static inline const void* vc4_bundle_code(const vc4_bundle* b, const vc4_bundle_program* p)
+{	return b->base + p->code;
+}
+
+/// Look up an entry label of a program.
+/// @param value [out] Byte offset of the label within the code.
+/// @return 0 if the label does not exist.
+static inline int vc4_bundle_label(const vc4_bundle* b, const vc4_bundle_program* p, const char* label, uint32_t* value)
+{	const vc4_bundle_header* h = vc4_bundle_hdr(b);
+	const vc4_bundle_entry* e = (const vc4_bundle_entry*)(b->base + h->entry_offset) + p->entry;
+	uint32_t n;
+	if (h->entry_offset > b->size || (b->size - h->entry_offset) / sizeof(vc4_bundle_entry) < (uint64_t)p->entry + p->entry_count)
+		return 0;
+	for (n = p->entry_count; n; --n, ++e)
+		if (e->name < b->size && strncmp(vc4_bundle_string(b, e->name), label, b->size - e->name) == 0)
+		{	*value = e->value;
+			return 1;
+		}
+	return 0;
+}
+
+/// Check the code of a program against its checksum.
+/// This reads the entire code, so it is not done by vc4_bundle_find.
+/// @return 0 if the code is corrupted.
+static inline int vc4_bundle_verify(const vc4_bundle* b, const vc4_bundle_program* p)
+{	const uint8_t* cp = (const uint8_t*)vc4_bundle_code(b, p);
+	const uint8_t* end = cp + p->size;
+	uint64_t h = 14695981039346656037ULL;
+	while (cp != end)
+		h = (h ^ *cp++) * 1099511628211ULL;
+	return h == p->checksum;
+}
+
+#endif // VC4BUNDLE_H_
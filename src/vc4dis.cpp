@@ -109,7 +109,7 @@ static void file_load_x64(const char *filename, vector<uint64_t>& memory)
 int main(int argc, char * argv[]) {
 	if (argc < 2) {
 		fputs("vc4dis V0.1\n"
-			"Usage: vc4dis [-x[32|64]] [-M] [-F] [-v] [-b <addr>] [-o <out_file>] [-V] <code_file(s)>\n"
+			"Usage: vc4dis [-x[32|64]] [-M] [-F] [-v] [-b <addr>] [-g <debug-map>] [-o <out_file>] [-V] <code_file(s)>\n"
 			" -x    Hexadecimal input, comma separated (rather than binary).\n"
 			" -x64  64 bit formatted hexadecimal input.\n"
 			" -M    Do not print simple ALU instructions and load immediate as mov.\n"
@@ -117,6 +117,7 @@ int main(int argc, char * argv[]) {
 			" -v    Binary code and offset as comment behind each line.\n"
 			" -v2   Write internal instruction field as comment behind every line also.\n"
 			" -b<addr> base address (only for output).\n"
+			" -g<file> Print the source locations from the debug map of vc4asm -g.\n"
 			" -o<file> Write output to this file rather than stdout.\n"
 			" -V    Run instruction verifier and print warnings about suspicious code.\n"
 			, stderr);
@@ -126,9 +127,10 @@ int main(int argc, char * argv[]) {
 	Disassembler dis;
 	dis.Out = stdout;
 	bool check = false;
+	DebugMap debug;
 
 	int c;
-	while ((c = getopt(argc, argv, "x::MFv::b:o:V")) != -1)
+	while ((c = getopt(argc, argv, "x::MFv::b:g:o:V")) != -1)
 	{	switch (c)
 		{case 'x':
 			if (!optarg || (hexinput = atoi(optarg)) == 0)
@@ -145,6 +147,13 @@ int main(int argc, char * argv[]) {
 			break;
 		 case 'b':
 			dis.BaseAddr = atol(optarg); break;
+		 case 'g':
+			if (!debug.Load(optarg))
+			{	fprintf(stderr, "Failed to read %s: %s\n", optarg, strerror(errno));
+				return 1;
+			}
+			dis.Debug = &debug;
+			break;
 		 case 'o':
 			dis.Out = fopen(optarg, "w");
 			if (!dis.Out)
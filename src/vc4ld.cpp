@@ -0,0 +1,160 @@
+/*
+ * vc4ld.cpp
+ *
+ *  Created on: 18.10.2026
+ */
+
+#include "Object.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <getopt.h>
+#include <unordered_map>
+
+using namespace std;
+
+
+#if (defined(__BIG_ENDIAN__) && __BIG_ENDIAN__) || (defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN)
+/// Byte swap
+static inline uint64_t swap_uint64(uint64_t x)
+{	x = x << 32 | x >> 32;
+	x = (x & 0x0000FFFF0000FFFFULL) << 16 | (x & 0xFFFF0000FFFF0000ULL) >> 16;
+	return (x & 0x00FF00FF00FF00FFULL) << 8  | (x & 0xFF00FF00FF00FF00ULL) >> 8;
+}
+#endif
+
+static const char CPPTemplate[] = ",\n0x%08lx, 0x%08lx";
+
+/// Input object of the linker.
+struct module
+{	const char*    File;
+	Object         Obj;
+	uint32_t       Base;        ///< Byte offset of the code in the result
+};
+
+/// Merge the code of all modules and resolve their relocations.
+/// @param base Address of the result in GPU memory.
+/// @return false on error.
+static bool link(vector<module>& modules, uint32_t base, vector<uint64_t>& code)
+{	// Place the modules and collect the exported symbols.
+	unordered_map<string,const module*> exports;
+	unordered_map<string,uint32_t> addresses;
+	bool ok = true;
+	for (module& mod : modules)
+	{	mod.Base = code.size() * sizeof(uint64_t);
+		code.insert(code.end(), mod.Obj.Code.begin(), mod.Obj.Code.end());
+		for (const auto& sym : mod.Obj.Symbols)
+			if (sym.Defined)
+			{	auto ret = exports.emplace(sym.Name, &mod);
+				if (!ret.second)
+				{	fprintf(stderr, "Symbol %s of %s is already defined in %s.\n", sym.Name.c_str(), mod.File, ret.first->second->File);
+					ok = false;
+				}
+				addresses.emplace(sym.Name, mod.Base + sym.Value);
+			}
+	}
+
+	for (const module& mod : modules)
+		for (const auto& rel : mod.Obj.Relocs)
+		{	uint32_t target = mod.Base;
+			if (rel.Symbol)
+			{	const auto& sym = mod.Obj.Symbols[rel.Symbol - 1];
+				auto addr = addresses.find(sym.Name);
+				if (addr == addresses.end())
+				{	fprintf(stderr, "Undefined symbol %s referenced by %s.\n", sym.Name.c_str(), mod.File);
+					ok = false;
+					continue;
+				}
+				target = sym.Defined ? mod.Base + sym.Value : addr->second;
+			}
+			Object::Patch(code[mod.Base / sizeof(uint64_t) + rel.Inst], rel.Type == Object::R_ABS ? base + target : target - mod.Base);
+		}
+	return ok;
+}
+
+static bool writeC(const char* fname, const vector<uint64_t>& instructions, const char* trailer)
+{	FILE* of = fopen(fname, "wt");
+	if (of == NULL)
+	{	fprintf(stderr, "Failed to open %s for writing.\n", fname);
+		return false;
+	}
+	const char* tpl = CPPTemplate + 2; // no ,\n in the first line
+	for (auto code : instructions)
+	{	fprintf(of, tpl, (unsigned long)(code & 0xffffffffULL), (unsigned long)(code >> 32) );
+		tpl = CPPTemplate;
+	}
+	fputs(trailer, of);
+	fclose(of);
+	return true;
+}
+
+int main(int argc, char **argv)
+{	const char* outFName = NULL;
+	const char* writeCPP = NULL;
+	const char* writeCPP2 = NULL;
+	uint32_t base = 0;
+
+	int c;
+	while ((c = getopt(argc, argv, "o:c:C:b:")) != -1)
+	{	switch (c)
+		{case 'o':
+			outFName = optarg; break;
+		 case 'c':
+			writeCPP = optarg; break;
+		 case 'C':
+			writeCPP2 = optarg; break;
+		 case 'b':
+			base = strtoul(optarg, NULL, 0); break;
+		 default:
+			return 1;
+		}
+	}
+
+	if (optind == argc || (!outFName && !writeCPP && !writeCPP2))
+	{	fputs("vc4ld V0.1\n"
+			"Usage: vc4ld [-o <bin-output>] [-{c|C} <c-output>] [-b <addr>] <object-file(s)>\n"
+			" -o<file> Binary output file.\n"
+			" -c<file> C output file with trailing ','.\n"
+			" -C<file> C output file withOUT trailing ','.\n"
+			" -b<addr> Base address of the code in GPU memory, applied to absolute\n"
+			"          branches and label values loaded by ldi.\n"
+			"The objects are created by vc4asm -r and placed in order of the arguments.\n"
+			, stderr);
+		return 1;
+	}
+
+	vector<module> modules(argc - optind);
+	for (module& mod : modules)
+	{	mod.File = argv[optind++];
+		if (!mod.Obj.Load(mod.File))
+		{	fprintf(stderr, "Failed to read %s: %s\n", mod.File, strerror(errno));
+			return 1;
+		}
+	}
+
+	vector<uint64_t> code;
+	if (!link(modules, base, code))
+		return 1;
+
+	if (writeCPP && !writeC(writeCPP, code, ",\n"))
+		return 1;
+	if (writeCPP2 && !writeC(writeCPP2, code, "\n"))
+		return 1;
+	if (outFName)
+	{
+		#if (defined(__BIG_ENDIAN__) && __BIG_ENDIAN__) || (defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN)
+		for (auto& i : code)
+			i = swap_uint64(i);
+		#endif
+		FILE* of = fopen(outFName, "wb");
+		if (of == NULL)
+		{	fprintf(stderr, "Failed to open %s for writing.\n", outFName);
+			return 1;
+		}
+		fwrite(code.data(), sizeof(uint64_t), code.size(), of);
+		fclose(of);
+	}
+	return 0;
+}
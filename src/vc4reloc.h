@@ -0,0 +1,48 @@
+/*
+ * vc4reloc.h
+ *
+ *  Created on: 18.10.2026
+ */
+
+#ifndef VC4RELOC_H_
+#define VC4RELOC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Load time relocation of QPU code written by vc4asm -o <code> -p <relocs>.
+/// The relocation list contains the indices of the instructions whose immediate
+/// value is an absolute code address, i.e. absolute branches to labels and label
+/// values loaded by ldi. These addresses are assembled relative to the start of the code.
+/// So the same code can be placed anywhere in GPU memory and shared between jobs
+/// without reassembly, e.g.:
+///
+///   memcpy(arm_ptr, code, code_size);
+///   vc4_relocate(arm_ptr, relocs, reloc_count, bus_addr);
+///
+/// The code is patched in place and may be relocated again
+/// by the difference of the new and the old address.
+/// Code and relocation list are little endian, the host byte order does not matter.
+/// Header only, no dependencies.
+
+/// Add an address to the absolute code addresses of a QPU program.
+/// @param code QPU instructions, 8 bytes each.
+/// @param relocs Instruction indices from the relocation list, 32 bit little endian.
+/// @param count Number of relocations, i.e. size of the relocation list / 4.
+/// @param addr GPU bus address of the first instruction.
+static inline void vc4_relocate(void* code, const void* relocs, size_t count, uint32_t addr)
+{	const uint8_t* rp = (const uint8_t*)relocs;
+	for (; count; --count, rp += 4)
+	{	uint32_t index = rp[0] | rp[1] << 8 | rp[2] << 16 | (uint32_t)rp[3] << 24;
+		// The immediate value is the low word of the instruction.
+		uint8_t* ip = (uint8_t*)code + 8 * (size_t)index;
+		uint32_t value = ip[0] | ip[1] << 8 | ip[2] << 16 | (uint32_t)ip[3] << 24;
+		value += addr;
+		ip[0] = (uint8_t)value;
+		ip[1] = (uint8_t)(value >> 8);
+		ip[2] = (uint8_t)(value >> 16);
+		ip[3] = (uint8_t)(value >> 24);
+	}
+}
+
+#endif // VC4RELOC_H_
@@ -0,0 +1,87 @@
+/*
+ * api.c
+ *
+ * Test of the C interface of libvc4asm, see Makefile.
+ * Usage: api_test <qasm-file> <output>
+ */
+
+#include "../src/libvc4asm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* buffer = NULL;
+
+/// Read source files from disk like a host application might do from its resources.
+static int reader(void* user, const char* file, const char** text, size_t* size)
+{	FILE* f = fopen(file, "rb");
+	(void)user;
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	free(buffer);
+	buffer = malloc(*size + 1);
+	if (fread(buffer, 1, *size, f) != *size)
+	{	fclose(f);
+		return 0;
+	}
+	fclose(f);
+	*text = buffer;
+	return 1;
+}
+
+/// Assemble and print the diagnostics.
+/// @return Copy of the instructions or NULL on error.
+static uint64_t* assemble(vc4asm_context* ctx, const char* text, size_t* count)
+{	const uint64_t* code;
+	uint64_t* copy;
+	size_t i;
+	int ok = vc4asm_assemble(ctx, "api.qasm", text, strlen(text), 0);
+	for (i = 0; i < vc4asm_diagnostic_count(ctx); ++i)
+		fputs(vc4asm_diagnostic(ctx, i, NULL), stderr);
+	if (!ok)
+		return NULL;
+	code = vc4asm_code(ctx, count);
+	copy = malloc(*count * sizeof *code + 1);
+	memcpy(copy, code, *count * sizeof *code);
+	return copy;
+}
+
+int main(int argc, char** argv)
+{	char text[1024];
+	vc4asm_context* ctx;
+	uint64_t* code[3];
+	size_t count[3];
+	FILE* of;
+	if (argc != 3)
+	{	fputs("Usage: api_test <qasm-file> <output>\n", stderr);
+		return 1;
+	}
+	snprintf(text, sizeof text, ".include \"../share/vc4.qinc\"\n.include \"%s\"\n", argv[1]);
+
+	// Reuse of a context and a new context must give the same result.
+	ctx = vc4asm_create(reader, NULL);
+	code[0] = assemble(ctx, text, &count[0]);
+	code[1] = assemble(ctx, text, &count[1]);
+	vc4asm_destroy(ctx);
+	ctx = vc4asm_create(reader, NULL);
+	code[2] = assemble(ctx, text, &count[2]);
+	vc4asm_destroy(ctx);
+	if (!code[0] || !code[1] || !code[2])
+		return 1;
+	if (count[1] != count[0] || memcmp(code[1], code[0], count[0] * sizeof *code[0])
+		|| count[2] != count[0] || memcmp(code[2], code[0], count[0] * sizeof *code[0]))
+	{	fputs("Repeated assembly gives different code.\n", stderr);
+		return 1;
+	}
+
+	of = fopen(argv[2], "wb");
+	if (!of || fwrite(code[0], sizeof *code[0], count[0], of) != count[0] || fclose(of) != 0)
+	{	perror(argv[2]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,8 @@
+# Program of the -j test that takes longest and has a warning, see Makefile.
+
+.include "gpu_fft_2048k.qasm"
+:batch_end
+	bra -, :batch_end
+	nop
+	nop
+	nop
@@ -0,0 +1,40 @@
+/*
+ * bundle.c
+ *
+ * Test of vc4bundle.h, see Makefile.
+ * Usage: bundle <bundle> <program> <output>
+ */
+
+#include "../src/vc4bundle.h"
+
+#include <stdio.h>
+
+int main(int argc, char** argv)
+{	vc4_bundle b;
+	const vc4_bundle_program* p;
+	FILE* of;
+	if (argc != 4)
+	{	fputs("Usage: bundle <bundle> <program> <output>\n", stderr);
+		return 1;
+	}
+	if (vc4_bundle_open(&b, argv[1]) != 0)
+	{	perror(argv[1]);
+		return 1;
+	}
+	p = vc4_bundle_find(&b, argv[2]);
+	if (!p)
+	{	fprintf(stderr, "Program %s not found in %s.\n", argv[2], argv[1]);
+		return 1;
+	}
+	if (!vc4_bundle_verify(&b, p))
+	{	fprintf(stderr, "Checksum of program %s does not match.\n", argv[2]);
+		return 1;
+	}
+	of = fopen(argv[3], "wb");
+	if (!of || fwrite(vc4_bundle_code(&b, p), 1, p->size, of) != p->size || fclose(of) != 0)
+	{	perror(argv[3]);
+		return 1;
+	}
+	vc4_bundle_close(&b);
+	return 0;
+}
@@ -0,0 +1,11 @@
+# Source of the test of -k, see Makefile.
+# cache.qinc is written by the test.
+
+.include "cache.qinc"
+:start
+	mov r0, value
+	# warning that must be reported by cache hits too
+	bra -, :start
+	nop
+	nop
+	nop
@@ -0,0 +1,16 @@
+# Forward labels in combined load immediates, see Makefile.
+# Their value is not known when the instructions are combined.
+
+	# same label, combined
+	mov ra0, :a;
+	; mov rb0, :a
+	# label and constant, not combined
+	mov ra0, :b;
+	; mov rb0, 0
+	# same label in one line
+	mov ra0, :a; mov rb0, :a
+	nop
+:a
+	nop
+:b
+	nop
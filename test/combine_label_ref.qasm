@@ -0,0 +1,10 @@
+# combine_label.qasm with the label values as constants, see Makefile.
+
+	ldi ra0, 0x28;
+	; ldi rb0, 0x28
+	ldi ra0, 0x30;
+	; ldi rb0, 0
+	ldi ra0, 0x28; ldi rb0, 0x28
+	nop
+	nop
+	nop
@@ -0,0 +1,34 @@
+# Instructions combined with the previous one by a leading ';', see Makefile.
+
+:start
+	# add and mul ALU, combined
+	add ra0, ra1, rb1;
+	; fmul rb0, r0, r1
+	# two add ALU instructions, not combined
+	add ra0, ra1, rb1;
+	; sub rb0, r0, r1
+	# same register file for both outputs, not combined
+	add ra0, r0, r1;
+	; fmul ra2, r0, r1
+	# signal to an ALU instruction, combined
+	add ra0, r0, r1;
+	; thrsw
+	# two signals, not combined
+	nop; thrsw;
+	; ldtmu0
+	# ldi of the same value, combined
+	ldi ra0, 0x1234;
+	; ldi rb0, 0x1234
+	# ldi of different values, not combined
+	ldi ra0, 0x1234;
+	; ldi rb0, 0x5678
+	# ldi to an ALU instruction, not combined
+	add ra0, r0, r1;
+	; ldi rb0, 0x1234
+	# the same backward label, combined
+	mov ra0, :start;
+	; mov rb0, :start
+	# a backward label and a constant of the same value, combined
+	mov ra0, :start + 8;
+	; mov rb0, 8
+	nop
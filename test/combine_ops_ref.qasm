@@ -0,0 +1,19 @@
+# combine_ops.qasm with the combined instructions in one line, see Makefile.
+
+:start
+	add ra0, ra1, rb1; fmul rb0, r0, r1
+	add ra0, ra1, rb1
+	sub rb0, r0, r1
+	add ra0, r0, r1
+	fmul ra2, r0, r1
+	add ra0, r0, r1; thrsw
+	thrsw
+	ldtmu0
+	ldi ra0, 0x1234; ldi rb0, 0x1234
+	ldi ra0, 0x1234
+	ldi rb0, 0x5678
+	add ra0, r0, r1
+	ldi rb0, 0x1234
+	mov ra0, :start; mov rb0, :start
+	mov ra0, :start + 8; mov rb0, 8
+	nop
@@ -0,0 +1,16 @@
+# Debug map test, see Makefile.
+# Uses .include, macros and .rep, the warnings pin the lines within .rep.
+
+.include "debug.qinc"
+
+:start
+	mov r0, 1
+	twice r0
+:loop
+	.rep j, 3
+		bra -, :loop
+		nop
+	.endr
+	nop; thrend
+	nop
+	nop
@@ -0,0 +1,36 @@
+/*
+ * elf.c
+ *
+ * Test of the outputs -e and -H, see Makefile.
+ * Usage: elf_test <elf-code> <incbin-code>
+ */
+
+#include "elf_obj.h"
+#include "elf_inc.h"
+
+#include <stdio.h>
+
+__asm__(ELF_INC_INCBIN);
+
+static int save(const char* path, const uint32_t* start, const uint32_t* end, size_t size)
+{	FILE* of;
+	if ((size_t)((const char*)end - (const char*)start) != size)
+	{	fprintf(stderr, "Size of %s does not match.\n", path);
+		return 1;
+	}
+	of = fopen(path, "wb");
+	if (!of || fwrite(start, 1, size, of) != size || fclose(of) != 0)
+	{	perror(path);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{	if (argc != 3)
+	{	fputs("Usage: elf_test <elf-code> <incbin-code>\n", stderr);
+		return 1;
+	}
+	return save(argv[1], elf_obj_start, elf_obj_end, ELF_OBJ_SIZE)
+		|| save(argv[2], elf_inc_start, elf_inc_end, ELF_INC_SIZE);
+}
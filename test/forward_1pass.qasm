@@ -0,0 +1,4 @@
+# Forward labels fixed up in a single pass, see Makefile.
+
+	mov r3, 0
+.include "forward.qinc"
@@ -0,0 +1,9 @@
+# Forward labels in two passes, see Makefile.
+# The value of the forward label in .if is only known in the second pass.
+
+.if :end > :start
+	mov r3, 0
+.else
+	mov r3, 1
+.endif
+.include "forward.qinc"
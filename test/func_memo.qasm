@@ -0,0 +1,25 @@
+# Memoized functional macros and .set functions, see Makefile.
+# Redefining a global constant that the body reads must invalidate the results.
+
+.set base, 1
+.func addbase(x)
+	.if x > 4
+		x + base
+	.else
+		addbase(x + 1)
+	.endif
+.endf
+.set mulbase(x) x * base
+
+	mov r0, addbase(2)
+	mov r1, mulbase(2)
+	mov r2, log2(1024)
+	mov r0, addbase(2)
+	mov r1, mulbase(2)
+.set base, 10
+	mov r0, addbase(2)
+	mov r1, mulbase(2)
+	mov r2, log2(1024)
+.set base, 1
+	mov r0, addbase(2)
+	mov r1, mulbase(2)
@@ -0,0 +1,12 @@
+# func_memo.qasm with the function values, see Makefile.
+
+	mov r0, 6
+	mov r1, 2
+	mov r2, 10
+	mov r0, 6
+	mov r1, 2
+	mov r0, 15
+	mov r1, 20
+	mov r2, 10
+	mov r0, 6
+	mov r1, 2
@@ -0,0 +1,20 @@
+# Compiled .set functions with dynamically scoped symbols, see Makefile.
+
+.set scale, 2
+.set f(x) x * scale + offset(x)
+# defined after f, resolved at invocation
+.set offset(x) x - 1
+# f sees the argument of g
+.set g(scale) f(10)
+# f sees the constant set by the macro, which stays defined
+.func h(s)
+	.set scale, s
+	f(10)
+.endf
+
+	mov r0, f(10)
+	mov r1, g(3)
+	mov r2, h(4)
+	mov r3, f(10)
+.set scale, 5
+	mov r0, f(10)
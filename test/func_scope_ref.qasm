@@ -0,0 +1,7 @@
+# func_scope.qasm with the function values, see Makefile.
+
+	mov r0, 29
+	mov r1, 39
+	mov r2, 49
+	mov r3, 49
+	mov r0, 59
@@ -0,0 +1,4 @@
+# Both modules of the linker test as one file, see Makefile.
+
+.include "link_main.qasm"
+.include "link_sub.qasm"
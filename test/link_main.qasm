@@ -0,0 +1,20 @@
+# Main module of the linker test, see Makefile.
+# Uses a function of link_sub.qasm relative and absolute.
+
+.global start
+:start
+	mov r0, 3
+	brr ra0, r:square
+	nop
+	nop
+	nop
+	ldi r1, :square + 8
+	bra -, :loop
+	nop
+	nop
+	nop
+:loop
+	brr -, r:loop
+	nop
+	nop
+	nop
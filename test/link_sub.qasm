@@ -0,0 +1,11 @@
+# Second module of the linker test, see Makefile.
+
+.global square
+:square
+	mul24 r0, r0, r0
+	bra -, ra0
+	nop
+	nop
+	nop
+:data
+	ldi r2, :data
@@ -0,0 +1,50 @@
+/*
+ * relocate.c
+ *
+ * Test of vc4reloc.h, see Makefile.
+ * Usage: relocate <code> <relocs> <addr> <output>
+ */
+
+#include "../src/vc4reloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void* load(const char* path, size_t* size)
+{	FILE* f = fopen(path, "rb");
+	void* data;
+	if (!f)
+	{	perror(path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(*size + 1);
+	if (fread(data, 1, *size, f) != *size)
+	{	perror(path);
+		exit(1);
+	}
+	fclose(f);
+	return data;
+}
+
+int main(int argc, char** argv)
+{	size_t code_size, reloc_size;
+	void* code;
+	void* relocs;
+	FILE* of;
+	if (argc != 5)
+	{	fputs("Usage: relocate <code> <relocs> <addr> <output>\n", stderr);
+		return 1;
+	}
+	code = load(argv[1], &code_size);
+	relocs = load(argv[2], &reloc_size);
+	vc4_relocate(code, relocs, reloc_size / 4, (uint32_t)strtoul(argv[3], NULL, 0));
+	of = fopen(argv[4], "wb");
+	if (!of || fwrite(code, 1, code_size, of) != code_size || fclose(of) != 0)
+	{	perror(argv[4]);
+		return 1;
+	}
+	return 0;
+}
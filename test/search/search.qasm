@@ -0,0 +1,10 @@
+# Source of the -I test, see Makefile.
+
+# Exists also in search_inc1, the one next to this file is used.
+.include "search.qinc"
+# Only in the include directories, the first one is used.
+.include "search_inc.qinc"
+
+	mov r0, local
+	mov r1, inc
+	mov r2, nested
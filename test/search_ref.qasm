@@ -0,0 +1,5 @@
+# search/search.qasm with the values of the right include files, see Makefile.
+
+	mov r0, 1
+	mov r1, 2
+	mov r2, 3
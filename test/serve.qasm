@@ -0,0 +1,6 @@
+# Source of the test of --serve and --connect, see Makefile.
+# serve.dir/serve.qinc is written by the test.
+
+.include "serve.qinc"
+	mov r0, value
+	nop
@@ -0,0 +1,5 @@
+# token_long.qasm with the values of the long identifiers, see Makefile.
+
+	mov ra0, 1
+	mov ra1, 2
+	mov ra2, 3